@@ -1,22 +1,216 @@
-﻿#include <mutex>
+﻿#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "car.hpp"
+#include "car_io.hpp"
+#include "car_ordering.hpp"
+#include "car_pipeline.hpp"
+#include "checkpoint.hpp"
+#include "data_monitor.hpp"
+#include "digest_memo.hpp"
+#include "file_follower.hpp"
+#include "file_replace.hpp"
+#include "input_shards.hpp"
 #include "json.hpp"
+#include "make_aggregate.hpp"
+#include "perf_counters.hpp"
+#include "process_shards.hpp"
+#include "profiled_mutex.hpp"
+#include "result_cache.hpp"
+#include "result_monitor.hpp"
 #include "sha1.hpp"
+#include "shm_ring.hpp"
+#include "stage_stats.hpp"
+#include "top_k.hpp"
+#include "trace_events.hpp"
+#include "unix_socket_server.hpp"
 
 using namespace std;
 using json = nlohmann::json;
 
-// Define the Car struct with additional fields
-struct Car {
-	string make;
-	double consumption;
-	int power;
-	string hashCode;
-	double performanceScore;
+// Command line options
+struct ProgramOptions {
+	vector<string> inputPaths;
+	unsigned loaderThreads = 0;
+	bool useCache = true;
+	string cacheDirectory = "cache";
+	bool useMemo = true;
+	string memoPath = "digest_memo.json";
+	size_t topK = 0;
+	SortOrder order = { { SortKey::Make, true } }; // score:desc instead with --top-k and no --order or --top-by
+	bool orderGiven = false;
+	bool aggregate = false;
+	bool aggregateOnly = false;
+	size_t queueSize = 16;
+	QueueOrder queueOrder = QueueOrder::Lifo;
+	WaitPolicy waitPolicy = WaitPolicy::Park;
+	Dispatch dispatch = Dispatch::Shared;
+	bool stageStats = false;
+	bool lockStats = false;
+	string lockStatsPath;
+	string tracePath;
+	size_t traceBufferEvents = 1 << 16;
+	bool perfCounters = false;
+	bool quiet = false;
+	string socketPath;
+	string ringName;
+	unsigned ringCapacity = 4096;
+	unsigned processes = 0;
+	int shardWorkerFd = -1; // Set in a worker process started by the coordinator
+	bool follow = false;
+	double followInterval = 2.0; // Seconds between result snapshots in follow mode
+	string checkpointPath;
+	double checkpointInterval = 60.0;
+	bool resume = false;
 };
 
-// Function to calculate the performance score
-double calculatePerformanceScore(const Car& car) {
-	return car.power / car.consumption;
+// Function to parse the command line
+const char* usageText = "[input.json|input.ndjson|DIR|'PATTERN'...] [--loaders N] [--quiet] [--no-cache] [--cache-dir DIR] [--no-memo] [--memo FILE] [--top-k N] [--top-by score|make] [--order FIELD[:asc|desc],...] [--aggregate | --aggregate-only] [--queue-size N] [--queue-order lifo|fifo] [--wait-policy park|spin|adaptive] [--dispatch shared|round-robin|least-loaded] [--stats] [--lock-stats] [--lock-stats-out FILE] [--trace FILE] [--trace-buffer EVENTS] [--perf-counters] [--serve SOCKET] [--shm NAME] [--shm-capacity RECORDS] [--processes N] [--follow] [--follow-interval SECONDS] [--checkpoint FILE] [--checkpoint-interval SECONDS] [--resume]";
+
+bool parseOptions(int argc, char* argv[], ProgramOptions& options) {
+	try {
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			if (arg == "--no-cache") {
+				options.useCache = false;
+			}
+			else if (arg == "--cache-dir" && i + 1 < argc) {
+				options.cacheDirectory = argv[++i];
+			}
+			else if (arg == "--no-memo") {
+				options.useMemo = false;
+			}
+			else if (arg == "--memo" && i + 1 < argc) {
+				options.memoPath = argv[++i];
+			}
+			else if (arg == "--top-k" && i + 1 < argc) {
+				options.topK = stoul(argv[++i]);
+			}
+			else if (arg == "--top-by" && i + 1 < argc && (string(argv[i + 1]) == "score" || string(argv[i + 1]) == "make")) {
+				// Shorthand for the two most common top-K orderings
+				parseSortOrder(string(argv[++i]) + ":desc", options.order);
+				options.orderGiven = true;
+			}
+			else if (arg == "--order" && i + 1 < argc && parseSortOrder(argv[i + 1], options.order)) {
+				i++;
+				options.orderGiven = true;
+			}
+			else if (arg == "--queue-size" && i + 1 < argc) {
+				options.queueSize = stoul(argv[++i]);
+			}
+			else if (arg == "--queue-order" && i + 1 < argc && (string(argv[i + 1]) == "fifo" || string(argv[i + 1]) == "lifo")) {
+				options.queueOrder = string(argv[++i]) == "fifo" ? QueueOrder::Fifo : QueueOrder::Lifo;
+			}
+			else if (arg == "--wait-policy" && i + 1 < argc && parseWaitPolicy(argv[i + 1], options.waitPolicy)) {
+				i++;
+			}
+			else if (arg == "--dispatch" && i + 1 < argc && parseDispatch(argv[i + 1], options.dispatch)) {
+				i++;
+			}
+			else if (arg == "--stats") {
+				options.stageStats = true;
+			}
+			else if (arg == "--lock-stats") {
+				options.lockStats = true;
+			}
+			else if (arg == "--lock-stats-out" && i + 1 < argc) {
+				options.lockStats = true;
+				options.lockStatsPath = argv[++i];
+			}
+			else if (arg == "--trace" && i + 1 < argc) {
+				options.tracePath = argv[++i];
+			}
+			else if (arg == "--trace-buffer" && i + 1 < argc) {
+				options.traceBufferEvents = stoul(argv[++i]);
+			}
+			else if (arg == "--perf-counters") {
+				options.perfCounters = true;
+			}
+			else if (arg == "--loaders" && i + 1 < argc) {
+				options.loaderThreads = stoul(argv[++i]);
+			}
+			else if (arg == "--serve" && i + 1 < argc) {
+				options.socketPath = argv[++i];
+			}
+			else if (arg == "--shm" && i + 1 < argc) {
+				options.ringName = argv[++i];
+			}
+			else if (arg == "--shm-capacity" && i + 1 < argc) {
+				options.ringCapacity = stoul(argv[++i]);
+			}
+			else if (arg == "--processes" && i + 1 < argc) {
+				options.processes = stoul(argv[++i]);
+			}
+			else if (arg == "--shard-worker" && i + 1 < argc) {
+				options.shardWorkerFd = stoi(argv[++i]);
+			}
+			else if (arg == "--follow") {
+				options.follow = true;
+			}
+			else if (arg == "--follow-interval" && i + 1 < argc) {
+				options.follow = true;
+				options.followInterval = stod(argv[++i]);
+			}
+			else if (arg == "--checkpoint" && i + 1 < argc) {
+				options.checkpointPath = argv[++i];
+			}
+			else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+				options.checkpointInterval = stod(argv[++i]);
+			}
+			else if (arg == "--resume") {
+				options.resume = true;
+			}
+			else if (arg == "--quiet") {
+				options.quiet = true;
+			}
+			else if (arg == "--aggregate") {
+				options.aggregate = true;
+			}
+			else if (arg == "--aggregate-only") {
+				options.aggregate = true;
+				options.aggregateOnly = true;
+			}
+			else if (!arg.empty() && arg[0] != '-') {
+				options.inputPaths.push_back(arg);
+			}
+			else {
+				cerr << "Unknown option: " << arg << endl;
+				cerr << "Usage: " << argv[0] << " " << usageText << endl;
+				return false;
+			}
+		}
+	}
+	catch (const exception&) {
+		cerr << "Invalid option value." << endl;
+		cerr << "Usage: " << argv[0] << " " << usageText << endl;
+		return false;
+	}
+	if (options.resume && options.checkpointPath.empty()) {
+		cerr << "--resume needs --checkpoint FILE." << endl;
+		return false;
+	}
+	if (options.topK > 0 && !options.orderGiven) {
+		// The K best cars by score, as before orderings were configurable
+		options.order = { { SortKey::Score, true } };
+	}
+	if (options.inputPaths.empty()) {
+		options.inputPaths.push_back("duomenys.json");
+	}
+	return true;
 }
 
 // Function to check if a car meets the filter criteria
@@ -24,306 +218,1006 @@ bool meetsFilterCriteria(const Car& car, double filterThreshold) {
 	return car.performanceScore > filterThreshold;
 }
 
-// Define the DataMonitor class for managing car data
-class DataMonitor {
-private:
-	array<Car, 16> dataBuffer; // Fixed-size array
-	int count = 0; // Keeps track of the number of elements in the buffer
-	condition_variable dataCondition;
+// Holds the final result for output: sorted cars and aggregates from the pipeline or the result cache
+ResultMonitor resultMonitor;
 
-public:
-	mutex monitorMutex;
-	bool isRunning = false;
-	bool shouldReturnEmpty = false;
+// Cars with more power than this pass the filter
+const int minPower = 100;
 
-	void isFinished()
-	{
-		isRunning = true;
+// Per-stage latency histograms for reading and parsing the input
+bool collectStageStats = false;
+
+// Function to print header and car data to console and file
+void printHeaderAndData(const vector<Car>& cars, int maxMakeWidth, int maxConsumptionWidth, int maxPowerWidth, bool toConsole) {
+	// Print the header to both console and file
+	if (toConsole) {
+		cout << " ----------------------------------" << endl;
+		cout << " | Car Data                       |" << endl;
+		cout << " ----------------------------------" << endl;
+		cout << " |" << setw(maxMakeWidth) << "Make      " << " |"
+			<< setw(maxConsumptionWidth) << " Consumption" << "|"
+			<< setw(maxPowerWidth) << "  Power" << "|" << '\n';
+		cout << " ----------------------------------" << endl;
 	}
 
-	// Add a car into the data buffer
-	void add(Car newCar) {
-		unique_lock<mutex> lock(monitorMutex);
-		dataCondition.wait(lock, [this] { return count < 16; });
-		dataBuffer[count++] = newCar;
-		dataCondition.notify_all();
+	ofstream outputFile("result.txt");
+	if (!outputFile) {
+		cerr << "Error opening the output file." << endl;
+		return;
+	}
 
-		// Output when an object is added to DataMonitor
-		//cout << endl;
-		cout << "Added car to DataMonitor. Count: " << count << endl;
-		//cout << endl;
+	outputFile << " ----------------------------------" << endl;
+	outputFile << " | Car Data                       |" << endl;
+	outputFile << " ----------------------------------" << endl;
+	outputFile << " |" << setw(maxMakeWidth) << "Make      " << " |"
+		<< setw(maxConsumptionWidth) << "Consumption " << "|"
+		<< setw(maxPowerWidth) << "  Power" << "|" << '\n';
+	outputFile << " ----------------------------------" << endl;
 
-		// Output when the DataMonitor is full
-		if (count == 16) {
-			cout << "DataMonitor is full. Waiting for space." << endl;
+	// Print the car data with adjusted widths to console and file
+	for (size_t i = 0; i < cars.size(); ++i) {
+		const auto& car = cars[i];
+		// Print to console
+		if (toConsole) {
+			cout << " |" << setw(maxMakeWidth) << car.make << "  |"
+				<< setw(11) << car.consumption << " |"
+				<< setw(maxPowerWidth) << car.power << "    |" << '\n';
 		}
+
+		// Print to file
+		outputFile << " |" << setw(maxMakeWidth) << car.make << "  |"
+			<< setw(11) << car.consumption << " |"
+			<< setw(maxPowerWidth) << car.power << "    |" << '\n';
 	}
 
-	// Remove a car from the data buffer
-	Car remove() {
-		Car car;
-		unique_lock<mutex> lock(monitorMutex);
-		dataCondition.wait(lock, [this] { return count > 0 || shouldReturnEmpty; });
+	// Close the file
+	outputFile << " ----------------------------------" << endl;
+	outputFile.close();
+
+	// Close the console output
+	if (toConsole) {
+		cout << " ----------------------------------" << endl;
+	}
+}
 
-		if (shouldReturnEmpty) {
-			car.power = -1;
+// Function to read the input cars: a JSON document {"cars": [...]} or NDJSON with one car per line.
+// Stage statistics: "read" covers the whole load, "parse" each record's decoding.
+bool readInputCars(const string& path, vector<Car>& cars, StageRecorder& recorder) {
+	optional<StageTimer> readTimer;
+	if (collectStageStats) {
+		readTimer.emplace();
+	}
+	ifstream inputFile(path);
+	if (!inputFile) {
+		cerr << "Error opening the input file " << path << endl;
+		return false;
+	}
+
+	try {
+		if (carFormatForPath(path) == CarFormat::Ndjson) {
+			string line;
+			while (getline(inputFile, line)) {
+				if (line.find_first_not_of(" \t\r") == string::npos) {
+					continue;
+				}
+				optional<StageTimer> parseTimer;
+				if (collectStageStats) {
+					parseTimer.emplace();
+				}
+				cars.push_back(carFromJson(json::parse(line)));
+				if (parseTimer) {
+					parseTimer->lap(recorder, Stage::Parse);
+				}
+			}
 		}
 		else {
-			car = dataBuffer[--count];
-			cout << "Removed car from DataMonitor. Count: " << count << endl;
-			//cout << endl;
+			string jsonData((istreambuf_iterator<char>(inputFile)), istreambuf_iterator<char>());
+			json jsonCars = json::parse(jsonData);
+
+			// Parse car data from JSON
+			for (const auto& carData : jsonCars["cars"]) {
+				optional<StageTimer> parseTimer;
+				if (collectStageStats) {
+					parseTimer.emplace();
+				}
+				cars.push_back(carFromJson(carData));
+				if (parseTimer) {
+					parseTimer->lap(recorder, Stage::Parse);
+				}
+			}
 		}
+	}
+	catch (const json::exception& e) {
+		cerr << "Error parsing the input file " << path << ": " << e.what() << endl;
+		return false;
+	}
 
-		dataCondition.notify_all();
+	if (readTimer) {
+		recorder.record(Stage::Read, readTimer->elapsedNanos(), cars.size());
+	}
+	return true;
+}
 
-		// Output when the DataMonitor is empty
-		if (count == 0) {
-			cout << "DataMonitor is empty. Waiting for data." << endl;
+// Function to parse the shards concurrently on the loader threads. With a pipeline given, each shard's cars
+// are submitted as soon as the shard is parsed, so the workers start before the last shard is read.
+// The input cars are returned in shard order. Returns false if any shard could not be read.
+bool loadShards(const vector<string>& shardPaths, unsigned loaderThreads, CarPipeline* pipeline, StageStats& stageStats, vector<Car>& cars) {
+	vector<vector<Car>> shardCars(shardPaths.size());
+	atomic<size_t> failedShards{ 0 };
+	forEachShard(shardPaths.size(), loaderThreads, [&](size_t shard) {
+		StageRecorder recorder;
+		{
+			string name = filesystem::path(shardPaths[shard]).filename().string();
+			TraceSpan parseSpan("parse shard", &name);
+			if (!readInputCars(shardPaths[shard], shardCars[shard], recorder)) {
+				failedShards++;
+				return;
+			}
+		}
+		if (collectStageStats) {
+			stageStats.merge(recorder);
+		}
+		if (pipeline) {
+			pipeline->submit(shardCars[shard]);
 		}
+	});
 
-		return car;
+	for (auto& shard : shardCars) {
+		cars.insert(cars.end(), shard.begin(), shard.end());
 	}
+	if (failedShards > 0) {
+		cerr << failedShards << " of " << shardPaths.size() << " input shards could not be read." << endl;
+		return false;
+	}
+	return true;
+}
 
-	// Get the current count of cars in the data buffer
-	int getCount() {
-		return count;
+// Function to format the per-make aggregates as a table, ordered by make
+string formatAggregates(const MakeAggregates& aggregates, int maxMakeWidth) {
+	vector<string> makes;
+	for (const auto& item : aggregates) {
+		makes.push_back(item.first);
 	}
-};
+	sort(makes.begin(), makes.end());
+
+	ostringstream table;
+	string dashHeader = " ----------------------------------------------------------------------------";
+	table << dashHeader << endl;
+	table << " | Make Aggregates                                                          |" << endl;
+	table << dashHeader << endl;
+	table << " |" << setw(maxMakeWidth) << "Make      " << " |" << setw(6) << "Count" << " |"
+		<< setw(24) << "Score mean/min/max" << " |" << setw(24) << "Power mean/min/max" << " |" << '\n';
+	table << dashHeader << endl;
+	table << fixed << setprecision(2);
+	for (const auto& make : makes) {
+		const MakeAggregate& aggregate = aggregates.at(make);
+		ostringstream score;
+		ostringstream power;
+		score << fixed << setprecision(2) << aggregate.meanScore() << "/" << aggregate.minScore << "/" << aggregate.maxScore;
+		power << fixed << setprecision(2) << aggregate.meanPower() << "/" << aggregate.minPower << "/" << aggregate.maxPower;
+		table << " |" << setw(maxMakeWidth) << make << "  |" << setw(6) << aggregate.count << " |"
+			<< setw(24) << score.str() << " |" << setw(24) << power.str() << " |" << '\n';
+	}
+	table << dashHeader << endl;
+	return table.str();
+}
+
+// Function to print the per-make aggregates to console and file
+void printAggregates(const MakeAggregates& aggregates, int maxMakeWidth) {
+	string table = formatAggregates(aggregates, maxMakeWidth);
+	cout << table;
+	ofstream outputFile("result.txt", ios::app);
+	if (outputFile) {
+		outputFile << table;
+	}
+}
 
-DataMonitor dataMonitor;
+// Function to print the monitor lock statistics and optionally export them as JSON
+void reportLockStats(const vector<LockStats>& locks, int threadCount, const string& exportPath) {
+	cout << "Lock statistics with " << threadCount << " worker threads:" << endl;
+	printLockStats(cout, locks);
 
-// ResultMonitor class for managing processed results
-class ResultMonitor {
-private:
-	array<Car, 16> resultBuffer; // Fixed-size array
-	int count = 0; // Keeps track of the number of elements in the buffer
-	condition_variable resultCondition;
-	mutex monitorMutex;
+	if (exportPath.empty()) {
+		return;
+	}
+	ofstream exportFile(exportPath);
+	if (!exportFile) {
+		cerr << "Error opening the lock statistics file." << endl;
+		return;
+	}
+	json report;
+	report["threads"] = threadCount;
+	report["locks"] = lockStatsToJson(locks);
+	exportFile << report.dump(2) << endl;
+}
 
-public:
-	bool isRunning = true;
+// Function to print how often waiting workers and the producer were served by spinning, yielding or parking
+void printWaitStats(ostream& out, WaitPolicy policy, const WaitStats& consumers, const WaitStats& producer) {
+	auto describe = [&](const char* side, const WaitStats& stats) {
+		out << "  " << side << ": " << stats.waits() << " waits, " << stats.spinHits << " ended spinning, "
+			<< stats.yieldHits << " yielding, " << stats.parks << " parked; spin budget " << stats.spinLimit << endl;
+	};
+	out << "Wait policy " << waitPolicyName(policy) << ":" << endl;
+	describe("workers", consumers);
+	describe("producer", producer);
+}
 
-	void addSorted(Car newCar) {
-		unique_lock<mutex> lock(monitorMutex);
+// Function to describe the filter configuration; part of the result cache key
+string filterConfigKey(double filterThreshold, int minPower, const ProgramOptions& options) {
+	string key = "threshold=" + to_string(filterThreshold) + ";minPower=" + to_string(minPower);
+	key += ";order=" + describeSortOrder(options.order);
+	if (options.topK > 0) {
+		key += ";top=" + to_string(options.topK);
+	}
+	if (options.aggregate) {
+		key += options.aggregateOnly ? ";aggregate=only" : ";aggregate=also";
+	}
+	return key;
+}
 
-		resultBuffer[count] = newCar;
-		count++;
+// Function to translate the command line into the pipeline settings
+PipelineConfig pipelineConfig(const ProgramOptions& options, int threadCount) {
+	PipelineConfig config;
+	config.workerThreads = threadCount;
+	config.queueSize = options.queueSize;
+	config.queueOrder = options.queueOrder;
+	config.waitPolicy = options.waitPolicy;
+	config.dispatch = options.dispatch;
+	config.order = options.order;
+	config.topK = options.topK;
+	config.aggregate = options.aggregate;
+	config.aggregateOnly = options.aggregateOnly;
+	config.minPower = minPower;
+	config.useMemo = options.useMemo;
+	config.stageStats = options.stageStats;
+	config.perfCounters = options.perfCounters;
+	config.lockStats = options.lockStats;
+	config.logging = !options.quiet;
+	return config;
+}
 
-		// Bubble Sort
-		for (int i = 0; i < count - 1; ++i) {
-			for (int j = 0; j < count - i - 1; ++j) {
-				if (resultBuffer[j].make < resultBuffer[j + 1].make) {
-					// Swap if the cars are in the wrong order
-					swap(resultBuffer[j], resultBuffer[j + 1]);
-				}
-			}
-		}
+#ifndef _WIN32
+// Function to run one request batch through the warm worker pool and build its response.
+json serveBatch(CarPipeline& pipeline, const json& request) {
+	auto start = chrono::steady_clock::now();
 
-		resultCondition.notify_all();
+	// Decode the whole batch first, so a malformed car rejects the request before any car is queued
+	vector<Car> batch;
+	for (const auto& carData : request.at("cars")) {
+		batch.push_back(carFromJson(carData));
 	}
 
-	// Get the result buffer
-	array<Car, 16> getFilteredCars() const {
-		return resultBuffer;
+	pipeline.submit(batch);
+	PipelineResult result = pipeline.drain();
+
+	json response;
+	response["received"] = result.received;
+	response["cars"] = json::array();
+	for (const auto& car : result.cars) {
+		response["cars"].push_back(processedCarToJson(car));
+	}
+	if (pipeline.getConfig().aggregate) {
+		response["aggregates"] = aggregatesToJson(result.aggregates);
 	}
+	response["micros"] = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	return response;
+}
 
-	// Get the current count of cars in the result buffer
-	int getCount() {
-		return count;
+// Function to serve car batches over a Unix domain socket with workers, monitors and digest memo kept warm.
+// Each request is one line of JSON {"cars": [...]}; each response is one line with the filtered, hashed and
+// sorted cars. {"shutdown": true} (or SIGINT/SIGTERM) stops the server.
+int runServer(const ProgramOptions& options, int threadCount) {
+	UnixSocketServer server(options.socketPath);
+	if (!server.listen()) {
+		return 1;
 	}
+	installServerStopHandlers();
 
-	void printResult(const Car& car, int maxMakeWidth, int maxConsumptionWidth, int maxPowerWidth) {
-		unique_lock<mutex> lock(monitorMutex);
+	CarPipeline pipeline;
+	if (options.useMemo) {
+		pipeline.memo().load(options.memoPath);
+	}
+	pipeline.configure(pipelineConfig(options, threadCount));
+	cout << "Serving on " << options.socketPath << " with " << threadCount << " worker threads." << endl;
 
-		string dashHeader = " ----------------------------------------------------------------------------";
-		string carHeader = " | Car Data                                                                 |";
+	size_t submittedCars = 0;
+	size_t requests = 0;
+	bool running = true;
+	while (running && !serverStopRequested) {
+		int client = server.accept();
+		if (client < 0) {
+			continue;
+		}
 
-		cout << dashHeader << endl;
-		cout << carHeader << endl;
-		cout << dashHeader << endl;
-		cout << " |" << setw(maxMakeWidth) << "Make      " << " |"
-			<< setw(maxConsumptionWidth) << " Consumption" << "|"
-			<< setw(maxPowerWidth) << "  Power" << "|"
-			<< setw(40) << "  Hash Code" << " |" << '\n';
-		cout << dashHeader << endl;
-		cout << " |" << setw(maxMakeWidth) << car.make << "  |"
-			<< setw(11) << car.consumption << " |"
-			<< setw(maxPowerWidth) << car.power << "    |"
-			<< setw(40) << car.hashCode << " |" << '\n';
-		cout << dashHeader << endl;
-
-		// Output what each thread is doing to both console and file
-		//cout << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Hash Code: " << car.hashCode << " | Performance Score: " << car.performanceScore << "\n";
-		cout << "Performance Score: " << car.performanceScore << "\n";
-
-		// Output to the result file
-		ofstream outputFile("result.txt", ios::app); // Open the file in append mode
-		if (outputFile) {
-			outputFile << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Hash Code: " << car.hashCode << " | Performance Score: " << car.performanceScore << "\n";
-			outputFile << dashHeader << endl;
-			outputFile << carHeader << endl;
-			outputFile << dashHeader << endl;
-			outputFile << " |" << setw(maxMakeWidth) << "Make      " << " |"
-				<< setw(maxConsumptionWidth) << "Consumption " << "|"
-				<< setw(maxPowerWidth) << "  Power" << "|"
-				<< setw(40) << "  Hash Code" << " |" << '\n';
-			outputFile << dashHeader << endl;
-			outputFile << " |" << setw(maxMakeWidth) << car.make << "  |"
-				<< setw(11) << car.consumption << " |"
-				<< setw(maxPowerWidth) << car.power << "    |"
-				<< setw(40) << car.hashCode << " |" << '\n';
-			outputFile << dashHeader << endl;
-			//outputFile << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Performance Score: " << car.performanceScore << "\n";
-			outputFile << "Performance Score: " << car.performanceScore << "\n";
+		SocketLineReader reader(client);
+		string request;
+		while (running && !serverStopRequested && reader.readLine(request)) {
+			if (request.find_first_not_of(" \t\r") == string::npos) {
+				continue;
+			}
+			json response;
+			try {
+				json body = json::parse(request);
+				if (body.value("shutdown", false)) {
+					running = false;
+					response["shutdown"] = true;
+				}
+				else {
+					response = serveBatch(pipeline, body);
+					submittedCars += response["received"].get<size_t>();
+					requests++;
+				}
+			}
+			catch (const json::exception& e) {
+				response = { { "error", e.what() } };
+			}
+			if (!writeAll(client, response.dump() + "\n")) {
+				break;
+			}
 		}
-		outputFile.close();
+		close(client);
 	}
-};
 
-ResultMonitor resultMonitor;
+	pipeline.shutdown();
+	cout << "Served " << requests << " requests with " << submittedCars << " cars." << endl;
 
-void processCarData(int threadCount, int maxMakeWidth, int maxConsumptionWidth, int maxPowerWidth, const array<Car, 16>& cars, string threadType, double filterThreshold) {
-	string dashHeader = " ----------------------------------------------------------------------------";
-	string carHeader = " | Car Data                                                                 |";
+	if (options.useMemo) {
+		cout << "Digest memo: reused " << pipeline.memo().getReusedCount()
+			<< ", recomputed " << pipeline.memo().getRecomputedCount() << "." << endl;
+		pipeline.memo().save(options.memoPath);
+	}
+	if (options.stageStats) {
+		pipeline.getStageStats().printSummary(cout);
+	}
+	if (!options.tracePath.empty()) {
+		TraceLog::instance().write(options.tracePath);
+	}
+	return 0;
+}
+#endif
 
-	while (true) {
-		if (dataMonitor.isRunning || dataMonitor.getCount() > 0)
-		{
-			Car car = dataMonitor.remove();
-			if (car.power == -1) {
-				break;
+#ifndef _WIN32
+// Function to run a worker process of the coordinator: read the partition's cars as NDJSON from the socket
+// until the coordinator shuts down its side, run them through the pipeline, and write back the sorted cars
+// (one JSON object per line) followed by {"done": true, "received": N, "aggregates": [...]}.
+int runShardWorker(const ProgramOptions& options, int threadCount) {
+	int fd = options.shardWorkerFd;
+	CarPipeline pipeline;
+	if (options.useMemo) {
+		pipeline.memo().load(options.memoPath);
+	}
+	PipelineConfig config = pipelineConfig(options, threadCount);
+	config.logging = false; // Standard output is not the coordinator's channel, but keep the worker quiet
+	pipeline.configure(config);
+
+	SocketLineReader reader(fd);
+	string line;
+	try {
+		while (reader.readLine(line)) {
+			if (line.find_first_not_of(" \t\r") != string::npos) {
+				pipeline.submit(carFromJson(json::parse(line)));
 			}
+		}
+	}
+	catch (const json::exception& e) {
+		pipeline.shutdown();
+		writeAll(fd, json({ { "error", e.what() } }).dump() + "\n");
+		return 1;
+	}
+	PipelineResult result = pipeline.drain();
+	pipeline.shutdown();
 
-			// Calculate SHA-1 hash for car data
-			SHA1 sha1;
-			sha1.update(car.make);
-			sha1.update(std::to_string(car.consumption));
-			sha1.update(std::to_string(car.power));
-			std::string hashCode = sha1.final();
-			car.hashCode = hashCode;
+	string output;
+	for (const auto& car : result.cars) {
+		output += processedCarToJson(car).dump();
+		output += '\n';
+		if (output.size() >= (1 << 20)) {
+			if (!writeAll(fd, output)) {
+				return 1;
+			}
+			output.clear();
+		}
+	}
+	json done = { { "done", true }, { "received", result.received }, { "aggregates", aggregatesToJson(result.aggregates) } };
+	output += done.dump() + "\n";
+	bool written = writeAll(fd, output);
+
+	if (options.useMemo) {
+		pipeline.memo().save(options.memoPath);
+	}
+	return written ? 0 : 1;
+}
+
+// Function to run the cars on `options.processes` worker processes, partitioned by make. Each worker gets
+// its own digest memo file (MEMO.shardI), since a make always lands on the same worker. The workers'
+// sorted outputs are merged into one result.
+bool runProcessShards(const vector<Car>& cars, const ProgramOptions& options, const string& executable, PipelineResult& result) {
+	size_t processCount = options.processes;
+	vector<vector<Car>> partitions(processCount);
+	for (const auto& car : cars) {
+		partitions[shardForMake(car.make, processCount)].push_back(car);
+	}
+
+	vector<WorkerProcess> workers(processCount);
+	for (size_t i = 0; i < processCount; i++) {
+		vector<string> args = { "--quiet", "--no-cache", "--order", describeSortOrder(options.order),
+			"--queue-size", to_string(options.queueSize), "--queue-order", options.queueOrder == QueueOrder::Fifo ? "fifo" : "lifo" };
+		if (options.dispatch != Dispatch::Shared) {
+			args.insert(args.end(), { "--dispatch", dispatchName(options.dispatch) });
+		}
+		if (options.topK > 0) {
+			args.insert(args.end(), { "--top-k", to_string(options.topK) });
+		}
+		if (options.aggregate) {
+			args.push_back(options.aggregateOnly ? "--aggregate-only" : "--aggregate");
+		}
+		if (options.useMemo) {
+			args.insert(args.end(), { "--memo", options.memoPath + ".shard" + to_string(i) });
+		}
+		else {
+			args.push_back("--no-memo");
+		}
+		args.push_back("--shard-worker");
+		if (!spawnWorkerProcess(executable, args, workers[i])) {
+			for (size_t j = 0; j < i; j++) {
+				shutdown(workers[j].fd, SHUT_RDWR);
+				waitWorkerProcess(workers[j]);
+			}
+			return false;
+		}
+	}
 
-			// Calculate the performance score
-			car.performanceScore = calculatePerformanceScore(car);
+	// One thread per worker sends its partition and then collects its output; a worker only answers
+	// after the end of its input, so the two directions never wait on each other
+	vector<vector<Car>> runs(processCount);
+	vector<MakeAggregates> aggregates(processCount);
+	vector<size_t> received(processCount, 0);
+	vector<string> errors(processCount);
+	vector<thread> channels;
+	for (size_t i = 0; i < processCount; i++) {
+		channels.emplace_back([&, i] {
+			TraceLog::instance().setThreadName("Shard " + to_string(i + 1));
+			int fd = workers[i].fd;
+			ostringstream input;
+			for (const auto& car : partitions[i]) {
+				writeCarJson(input, car, true);
+				input << '\n';
+				if (input.tellp() >= (1 << 20)) {
+					writeAll(fd, input.str());
+					input.str("");
+				}
+			}
+			writeAll(fd, input.str());
+			shutdown(fd, SHUT_WR);
 
-			// Check if the car meets the filter criteria
-			if (car.power > 100) {
-				// Add the result into the result monitor
-				resultMonitor.addSorted(car);
+			SocketLineReader reader(fd);
+			string line;
+			try {
+				while (reader.readLine(line)) {
+					json item = json::parse(line);
+					if (item.contains("error")) {
+						errors[i] = item["error"].get<string>();
+						return;
+					}
+					if (item.value("done", false)) {
+						received[i] = item.at("received").get<size_t>();
+						aggregates[i] = aggregatesFromJson(item.at("aggregates"));
+						return;
+					}
+					runs[i].push_back(processedCarFromJson(item));
+				}
+				errors[i] = "the output ended early";
+			}
+			catch (const json::exception& e) {
+				errors[i] = e.what();
 			}
+		});
+	}
+	for (auto& channel : channels) {
+		channel.join();
+	}
+
+	bool succeeded = true;
+	for (size_t i = 0; i < processCount; i++) {
+		if (!waitWorkerProcess(workers[i]) && errors[i].empty()) {
+			errors[i] = "the process failed";
 		}
-		else
-			break;
+		if (!errors[i].empty()) {
+			cerr << "Worker process " << i + 1 << ": " << errors[i] << endl;
+			succeeded = false;
+		}
+	}
+	if (!succeeded) {
+		return false;
 	}
+
+	result.cars = mergeSortedRuns(runs, makeCarOrdering(options.order), options.topK);
+	result.received = 0;
+	for (size_t i = 0; i < processCount; i++) {
+		mergeAggregates(result.aggregates, aggregates[i]);
+		result.received += received[i];
+	}
+	return true;
 }
+#endif
 
-// Function to print header and car data to console and file
-void printHeaderAndData(const array<Car, 16>& cars, int maxMakeWidth, int maxConsumptionWidth, int maxPowerWidth) {
-	// Print the header to both console and file
-	cout << " ----------------------------------" << endl;
-	cout << " | Car Data                       |" << endl;
-	cout << " ----------------------------------" << endl;
-	cout << " |" << setw(maxMakeWidth) << "Make      " << " |"
-		<< setw(maxConsumptionWidth) << " Consumption" << "|"
-		<< setw(maxPowerWidth) << "  Power" << "|" << '\n';
-	cout << " ----------------------------------" << endl;
+// Function to replace result.txt with the current result of a followed feed. The snapshot goes through
+// replaceFile, so a reader never sees half of it and a failed write keeps the previous snapshot.
+void writeFollowSnapshot(const vector<Car>& cars, const MakeAggregates& aggregates, bool aggregate) {
+	int maxMakeWidth = 0;
+	for (const auto& car : cars) {
+		maxMakeWidth = max(maxMakeWidth, int(car.make.length()));
+	}
+	for (const auto& item : aggregates) {
+		maxMakeWidth = max(maxMakeWidth, int(item.first.length()));
+	}
 
-	ofstream outputFile("result.txt");
-	if (!outputFile) {
-		cerr << "Error opening the output file." << endl;
-		return;
+	ostringstream snapshot;
+	for (const auto& car : cars) {
+		snapshot << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power
+			<< " | Hash Code: " << car.hashCode << " | Performance Score: " << car.performanceScore << "\n";
 	}
+	if (aggregate) {
+		snapshot << formatAggregates(aggregates, maxMakeWidth);
+	}
+	// Text mode, like the other writers of result.txt
+	replaceFile("result.txt", snapshot.str(), "output", ios::out);
+}
 
-	outputFile << " ----------------------------------" << endl;
-	outputFile << " | Car Data                       |" << endl;
-	outputFile << " ----------------------------------" << endl;
-	outputFile << " |" << setw(maxMakeWidth) << "Make      " << " |"
-		<< setw(maxConsumptionWidth) << "Consumption " << "|"
-		<< setw(maxPowerWidth) << "  Power" << "|" << '\n';
-	outputFile << " ----------------------------------" << endl;
+// Function to stream an NDJSON input through the warm pipeline in batches. The sorted result is kept up
+// to date by merging every batch into it. With --follow the records appended later are processed too and
+// result.txt is written at most once per --follow-interval until SIGINT/SIGTERM; otherwise the run ends at
+// the end of the file. With --checkpoint the consumed offset and the result are saved every
+// --checkpoint-interval, and --resume continues from there without reading the earlier records again.
+int runStreaming(const ProgramOptions& options, int threadCount, const string& configKey) {
+	const string& path = options.inputPaths[0];
+	if (options.inputPaths.size() > 1 || isShardSpec(path) || carFormatForPath(path) != CarFormat::Ndjson) {
+		cerr << "Follow and checkpoint modes need a single NDJSON input file (.ndjson or .jsonl)." << endl;
+		return 1;
+	}
+#ifndef _WIN32
+	installServerStopHandlers();
+	auto stopRequested = [] { return serverStopRequested != 0; };
+#else
+	auto stopRequested = [] { return false; };
+#endif
 
-	// Print the car data with adjusted widths to console and file
-	for (int i = 0; i < cars.size(); ++i) {
-		const auto& car = cars[i];
-		// Print to console
-		cout << " |" << setw(maxMakeWidth) << car.make << "  |"
-			<< setw(11) << car.consumption << " |"
-			<< setw(maxPowerWidth) << car.power << "    |" << '\n';
+	CarPipeline pipeline;
+	if (options.useMemo) {
+		pipeline.memo().load(options.memoPath);
+	}
+	PipelineConfig config = pipelineConfig(options, threadCount);
+	config.logging = false; // One line per car and monitor call would drown the snapshots
 
-		// Print to file
-		outputFile << " |" << setw(maxMakeWidth) << car.make << "  |"
-			<< setw(11) << car.consumption << " |"
-			<< setw(maxPowerWidth) << car.power << "    |" << '\n';
+	FileFollower follower(path);
+	CarOrdering ordering = makeCarOrdering(options.order);
+	vector<Car> resultCars;
+	MakeAggregates aggregates;
+	size_t followedCars = 0;
+	size_t skippedRecords = 0;
+
+	if (options.resume) {
+		Checkpoint checkpoint;
+		if (!loadCheckpoint(options.checkpointPath, checkpoint)) {
+			return 1;
+		}
+		if (checkpoint.configKey != configKey) {
+			cerr << "The checkpoint was made with other settings (" << checkpoint.configKey << ")." << endl;
+			return 1;
+		}
+		if (checkpoint.inputDigest != checkpointInputDigest(path, checkpoint.inputOffset)) {
+			cerr << "The checkpoint belongs to a different input than " << path << "." << endl;
+			return 1;
+		}
+		follower.resumeAt(checkpoint.inputOffset);
+		resultCars = move(checkpoint.cars);
+		aggregates = move(checkpoint.aggregates);
+		followedCars = checkpoint.processedCars;
+		skippedRecords = checkpoint.skippedRecords;
+		cout << "Resuming " << path << " at byte " << checkpoint.inputOffset << " after " << followedCars << " cars." << endl;
 	}
 
-	// Close the file
-	outputFile << " ----------------------------------" << endl;
-	outputFile.close();
+	auto writeCheckpoint = [&] {
+		Checkpoint checkpoint;
+		checkpoint.inputOffset = follower.getCompleteOffset();
+		checkpoint.processedCars = followedCars;
+		checkpoint.skippedRecords = skippedRecords;
+		checkpoint.configKey = configKey;
+		checkpoint.inputDigest = checkpointInputDigest(path, checkpoint.inputOffset);
+		checkpoint.cars = resultCars;
+		checkpoint.aggregates = aggregates;
+		saveCheckpoint(options.checkpointPath, checkpoint);
+	};
 
-	// Close the console output
-	cout << " ----------------------------------" << endl;
+	pipeline.configure(config);
+	cout << (options.follow ? "Following " : "Streaming ") << path << " with " << threadCount << " worker threads." << endl;
+
+	bool checkpointing = !options.checkpointPath.empty();
+	bool changed = true;
+	bool missingReported = false;
+	auto toDuration = [](double seconds) {
+		return chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+	};
+	auto interval = toDuration(options.followInterval);
+	auto checkpointInterval = toDuration(options.checkpointInterval);
+	auto nextSnapshot = chrono::steady_clock::now();
+	auto nextCheckpoint = nextSnapshot + checkpointInterval;
+
+	while (!stopRequested()) {
+		vector<string> lines;
+		if (!follower.readNewLines(lines)) {
+			if (!options.follow) {
+				cerr << "Error opening the input file " << path << endl;
+				return 1;
+			}
+			if (!missingReported) {
+				cerr << "Waiting for " << path << " to appear." << endl;
+				missingReported = true;
+			}
+		}
+		bool atEnd = lines.empty();
+		if (atEnd && !options.follow) {
+			follower.takePartialLine(lines);
+		}
+
+		if (!lines.empty()) {
+			missingReported = false;
+			for (const auto& line : lines) {
+				if (line.find_first_not_of(" \t\r") == string::npos) {
+					continue;
+				}
+				try {
+					pipeline.submit(carFromJson(json::parse(line)));
+				}
+				catch (const json::exception& e) {
+					// A feed keeps going past a bad record
+					if (skippedRecords++ == 0) {
+						cerr << "Skipping malformed record: " << e.what() << endl;
+					}
+				}
+			}
+			PipelineResult batch = pipeline.drain();
+
+			// Both lists are sorted; earlier records stay ahead of equal later ones
+			vector<Car> merged;
+			merged.reserve(resultCars.size() + batch.cars.size());
+			merge(resultCars.begin(), resultCars.end(), batch.cars.begin(), batch.cars.end(), back_inserter(merged), ordering);
+			if (options.topK > 0 && merged.size() > options.topK) {
+				merged.erase(merged.begin() + options.topK, merged.end());
+			}
+			resultCars.swap(merged);
+			mergeAggregates(aggregates, batch.aggregates);
+			followedCars += batch.received;
+			changed = true;
+		}
+
+		auto now = chrono::steady_clock::now();
+		if (checkpointing && now >= nextCheckpoint) {
+			writeCheckpoint();
+			nextCheckpoint = now + checkpointInterval;
+		}
+		if (!options.follow) {
+			if (atEnd) {
+				break;
+			}
+			continue;
+		}
+		if (changed && now >= nextSnapshot) {
+			writeFollowSnapshot(resultCars, aggregates, options.aggregate);
+			cout << "Followed " << followedCars << " cars (" << follower.getOffset() << " bytes): " << resultCars.size()
+				<< " in the result, " << aggregates.size() << " makes." << endl;
+			changed = false;
+			nextSnapshot = now + interval;
+		}
+
+		// Keep reading while a backlog remains; otherwise sleep until the file changes or a snapshot is due
+		if (lines.empty()) {
+			auto wait = changed ? chrono::duration_cast<chrono::milliseconds>(nextSnapshot - now).count() : 1000;
+			follower.waitForChange(int(max<long long>(1, min<long long>(wait, 1000))));
+		}
+	}
+
+	pipeline.shutdown();
+	if (checkpointing) {
+		writeCheckpoint();
+	}
+	if (changed) {
+		writeFollowSnapshot(resultCars, aggregates, options.aggregate);
+	}
+	cout << (options.follow ? "Stopped following " : "Streamed ") << path << " after " << followedCars << " cars." << endl;
+	if (skippedRecords > 0) {
+		cerr << "Skipped " << skippedRecords << " malformed records." << endl;
+	}
+
+	if (options.useMemo) {
+		cout << "Digest memo: reused " << pipeline.memo().getReusedCount()
+			<< ", recomputed " << pipeline.memo().getRecomputedCount() << "." << endl;
+		pipeline.memo().save(options.memoPath);
+	}
+	if (options.stageStats) {
+		pipeline.getStageStats().printSummary(cout);
+	}
+	if (!options.tracePath.empty()) {
+		TraceLog::instance().write(options.tracePath);
+	}
+	return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
 	//ResultMonitor resultMonitor;
 	const int threadCount = 4;
 	double filterThreshold = 50.0;
 
-	ifstream inputFile("duomenys.json");
-	string jsonData((istreambuf_iterator<char>(inputFile)), istreambuf_iterator<char>());
-	json jsonCars = json::parse(jsonData);
+	ProgramOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		return 1;
+	}
+	collectStageStats = options.stageStats;
+	if (!options.tracePath.empty()) {
+		TraceLog::instance().enable(options.traceBufferEvents);
+		TraceLog::instance().setThreadName("main");
+	}
+	StageRecorder mainRecorder;
+	CarPipeline pipeline;
+
+	if (options.shardWorkerFd >= 0) {
+#ifndef _WIN32
+		return runShardWorker(options, threadCount);
+#else
+		return 1;
+#endif
+	}
+	if (options.processes > 0 && !options.ringName.empty()) {
+		cerr << "--processes partitions input files and cannot be combined with --shm." << endl;
+		return 1;
+	}
+#ifdef _WIN32
+	if (options.processes > 0) {
+		cerr << "Multi-process execution is not available on this platform." << endl;
+		return 1;
+	}
+#endif
+
+	if (options.follow || !options.checkpointPath.empty()) {
+		return runStreaming(options, threadCount, filterConfigKey(filterThreshold, minPower, options));
+	}
+
+	if (!options.socketPath.empty()) {
+#ifndef _WIN32
+		return runServer(options, threadCount);
+#else
+		cerr << "Server mode needs Unix domain sockets and is not available on this platform." << endl;
+		return 1;
+#endif
+	}
+
+	// With --shm another process hands the cars over through a shared-memory ring; there is no input file
+	// to read or fingerprint, so the result cache is not used
+	bool ringMode = !options.ringName.empty();
+#ifdef __linux__
+	ShmCarRing ring;
+	if (ringMode) {
+		if (!ring.create(options.ringName, options.ringCapacity)) {
+			return 1;
+		}
+		options.useCache = false;
+	}
+#else
+	if (ringMode) {
+		cerr << "Shared-memory ingestion needs POSIX shared memory and futexes and is not available on this platform." << endl;
+		return 1;
+	}
+#endif
 
-	array<Car, 16> mainCars;
+	// Several paths, a directory or a wildcard pattern select sharded input
+	vector<string> shardPaths;
+	bool shardMode = !ringMode && (options.inputPaths.size() > 1 || isShardSpec(options.inputPaths[0]));
+	if (shardMode) {
+		for (const auto& spec : options.inputPaths) {
+			if (!isShardSpec(spec)) {
+				shardPaths.push_back(spec);
+			}
+			else if (!expandShardPaths(spec, shardPaths)) {
+				cerr << "Error listing the input shards " << spec << endl;
+				return 1;
+			}
+		}
+		if (shardPaths.empty()) {
+			cerr << "No input shards found." << endl;
+			return 1;
+		}
+	}
+	unsigned loaderThreads = loaderThreadCount(shardPaths.size(), options.loaderThreads);
 
-	// Parse car data from JSON
-	int i = 0;
-	for (const auto& carData : jsonCars["cars"]) {
-		Car car;
-		car.make = carData["make"];
-		car.consumption = carData["consumption"];
-		car.power = carData["power"];
-		mainCars[i++] = car;
+	// A single input file is read up front; shards are parsed by the loader threads further down
+	vector<Car> mainCars;
+	if (!shardMode && !ringMode && !readInputCars(options.inputPaths[0], mainCars, mainRecorder)) {
+		return 1;
 	}
 
 	int maxMakeWidth = 0;
 	int maxConsumptionWidth = 0;
 	int maxPowerWidth = 0;
+	auto measureColumns = [&](const vector<Car>& cars) {
+		for (const auto& car : cars) {
+			maxMakeWidth = max(maxMakeWidth, int(car.make.length()));
+			maxConsumptionWidth = max(maxConsumptionWidth, int(to_string(car.consumption).length()));
+			maxPowerWidth = max(maxPowerWidth, int(to_string(car.power).length()));
+		}
+	};
 
-	for (const auto& car : mainCars) {
-		maxMakeWidth = max(maxMakeWidth, int(car.make.length()));
-		maxConsumptionWidth = max(maxConsumptionWidth, int(to_string(car.consumption).length()));
-		maxPowerWidth = max(maxPowerWidth, int(to_string(car.power).length()));
+	if (!shardMode && !ringMode) {
+		measureColumns(mainCars);
+
+		// Call the printHeaderAndData function to print header and car data
+		printHeaderAndData(mainCars, maxMakeWidth, maxConsumptionWidth, maxPowerWidth, !options.quiet);
 	}
 
-	// Call the printHeaderAndData function to print header and car data
-	printHeaderAndData(mainCars, maxMakeWidth, maxConsumptionWidth, maxPowerWidth);
+	// Reuse the sorted result of an earlier run on the same input and filter configuration
+	ResultCache resultCache(options.cacheDirectory);
+	string cacheKey;
+	vector<Car> cachedCars;
+	MakeAggregates cachedAggregates;
+	bool cacheHit = false;
+	if (options.useCache) {
+		string filterConfig = filterConfigKey(filterThreshold, minPower, options);
+		if (shardMode) {
+			cacheKey = ResultCache::makeKey(fingerprintShards(shardPaths, loaderThreads), filterConfig);
+		}
+		else {
+			cacheKey = ResultCache::makeKey(options.inputPaths[0], filterConfig);
+		}
+		if (cacheKey.empty()) {
+			cerr << "The input could not be hashed; the result cache is not used for this run." << endl;
+		}
+		else {
+			cacheHit = resultCache.load(cacheKey, cachedCars, cachedAggregates);
+		}
+	}
 
-	vector<thread> threads;
-	for (int i = 0; i < threadCount; i++)
-	{
-		threads.emplace_back([&] {processCarData(i + 1, maxMakeWidth, maxConsumptionWidth, maxPowerWidth, mainCars, "WorkerThread", filterThreshold); });
+	if (cacheHit) {
+		cout << "Loaded " << cachedCars.size() << " cars from the result cache (" << cacheKey << ")." << endl;
+		resultMonitor.loadSorted(cachedCars, cachedAggregates);
+		if (shardMode && !loadShards(shardPaths, loaderThreads, nullptr, pipeline.getStageStats(), mainCars)) {
+			return 1;
+		}
 	}
+#ifndef _WIN32
+	else if (options.processes > 0) {
+		// Partition the cars by make across worker processes and merge their sorted outputs
+		if (shardMode && !loadShards(shardPaths, loaderThreads, nullptr, pipeline.getStageStats(), mainCars)) {
+			return 1;
+		}
+		PipelineResult result;
+		if (!runProcessShards(mainCars, options, currentExecutablePath(argv[0]), result)) {
+			return 1;
+		}
+		resultMonitor.loadSorted(result.cars, result.aggregates);
+		cout << "Processed " << result.received << " cars on " << options.processes << " worker processes." << endl;
 
-	for (int i = 0; i < mainCars.size(); i++)
-	{
-		dataMonitor.add(mainCars[i]);
+		if (!cacheKey.empty()) {
+			resultCache.store(cacheKey, resultMonitor.getSortedCars(), resultMonitor.getAggregates());
+		}
 	}
+#endif
+	else {
+		if (options.useMemo) {
+			pipeline.memo().load(options.memoPath);
+		}
+		PipelineConfig config = pipelineConfig(options, threadCount);
+		// Every shard loader thread submits its own cars
+		config.concurrentSubmit = shardMode && loaderThreads > 1;
+#ifdef __linux__
+		if (ringMode) {
+			config.ring = &ring;
+		}
+#endif
+		pipeline.configure(config);
+
+		bool inputComplete = true;
+		if (shardMode) {
+			inputComplete = loadShards(shardPaths, loaderThreads, &pipeline, pipeline.getStageStats(), mainCars);
+		}
+		else if (ringMode) {
+			cout << "Waiting for cars on the shared memory ring " << options.ringName << " (" << options.ringCapacity << " records)." << endl;
+		}
+		else {
+			for (size_t i = 0; i < mainCars.size(); i++)
+			{
+				pipeline.submit(mainCars[i]);
+			}
+		}
 
-	// Signal threads to stop and wait for them to finish
-	dataMonitor.isFinished();
-	dataMonitor.shouldReturnEmpty = true;
-	for_each(threads.begin(), threads.end(), mem_fn(&thread::join));
+		// Wait for the queued cars to be processed and stop the workers; the ring ends when its producer closes it
+		PipelineResult result = ringMode ? pipeline.finish() : pipeline.drain();
+		pipeline.shutdown();
+		if (!inputComplete) {
+			return 1;
+		}
+#ifdef __linux__
+		if (ringMode && ring.isPeerLost()) {
+			cerr << "The producer of " << options.ringName << " exited without closing the ring; the input is incomplete." << endl;
+			return 1;
+		}
+#endif
+		resultMonitor.loadSorted(result.cars, result.aggregates);
+		if (ringMode) {
+			cout << "Received " << result.received << " cars through the shared memory ring." << endl;
+		}
 
-	//this_thread::sleep_for(std::chrono::seconds(10));
+		// Print a message indicating that the DataMonitor is completely empty
+		cout << "DataMonitor is completely empty." << endl;
 
-	// Print a message indicating that the DataMonitor is completely empty
-	cout << "DataMonitor is completely empty." << endl;
+		if (options.perfCounters) {
+			pipeline.getPerfReport().print(cout);
+		}
+		if (options.lockStats) {
+			reportLockStats(pipeline.getLockStats(), threadCount, options.lockStatsPath);
+		}
+
+		// Ring cars skip the DataMonitor, so there is no queue latency to report
+		if (!ringMode) {
+			QueueLatencyStats latency = pipeline.getQueueLatency();
+			// Per-worker queues are always FIFO
+			string queueKind = options.dispatch != Dispatch::Shared ? string("fifo, ") + dispatchName(options.dispatch)
+				: options.queueOrder == QueueOrder::Fifo ? "fifo" : "lifo";
+			cout << "Queue latency (" << queueKind << "): mean "
+				<< latency.meanMicros() << " us, max " << latency.maxMicros() << " us over " << latency.count << " cars." << endl;
+		}
+		if (options.waitPolicy != WaitPolicy::Park && !ringMode) {
+			printWaitStats(cout, options.waitPolicy, pipeline.getConsumerWaitStats(), pipeline.getProducerWaitStats());
+		}
+
+		if (options.useMemo) {
+			cout << "Digest memo: reused " << pipeline.memo().getReusedCount()
+				<< ", recomputed " << pipeline.memo().getRecomputedCount() << "." << endl;
+			pipeline.memo().save(options.memoPath);
+		}
+
+		if (!cacheKey.empty()) {
+			resultCache.store(cacheKey, resultMonitor.getSortedCars(), resultMonitor.getAggregates());
+		}
+	}
+
+	if (shardMode) {
+		cout << "Read " << mainCars.size() << " cars from " << shardPaths.size() << " shards on " << loaderThreads << " loader threads." << endl;
+		measureColumns(mainCars);
+		printHeaderAndData(mainCars, maxMakeWidth, maxConsumptionWidth, maxPowerWidth, !options.quiet);
+	}
 
 	// Print the results directly from the result monitor
-	array<Car, 16> sortedCars;
-	sortedCars = resultMonitor.getFilteredCars();
-	for (size_t i = 0; i < resultMonitor.getCount(); i++)
+	vector<Car> sortedCars = resultMonitor.getSortedCars();
+	if (ringMode) {
+		// Only the results are known; size the columns from them and start a fresh result file
+		measureColumns(sortedCars);
+		for (const auto& item : resultMonitor.getAggregates()) {
+			maxMakeWidth = max(maxMakeWidth, int(item.first.length()));
+		}
+		ofstream("result.txt");
+	}
+	for (size_t i = 0; i < sortedCars.size(); i++)
 	{
-		resultMonitor.printResult(sortedCars[i], maxMakeWidth, maxConsumptionWidth, maxPowerWidth);
+		optional<StageTimer> outputTimer;
+		if (collectStageStats) {
+			outputTimer.emplace();
+		}
+		resultMonitor.printResult(sortedCars[i], maxMakeWidth, maxConsumptionWidth, maxPowerWidth, !options.quiet);
+		if (outputTimer) {
+			outputTimer->lap(mainRecorder, Stage::Output);
+		}
+	}
+
+	if (options.aggregate) {
+		printAggregates(resultMonitor.getAggregates(), maxMakeWidth);
+	}
+
+	if (collectStageStats) {
+		pipeline.getStageStats().merge(mainRecorder);
+		pipeline.getStageStats().printSummary(cout);
+	}
+
+	if (!options.tracePath.empty()) {
+		TraceLog::instance().write(options.tracePath);
 	}
 	return 0;
 }
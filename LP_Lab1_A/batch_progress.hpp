@@ -0,0 +1,36 @@
+#ifndef BATCH_PROGRESS_HPP
+#define BATCH_PROGRESS_HPP
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+
+// Counts the cars whose results the workers have published, so a long-running pipeline can wait
+// for a batch without stopping its workers. The count only grows; callers wait for a running total.
+class BatchProgress {
+private:
+	std::mutex progressMutex;
+	std::condition_variable progressed;
+	std::size_t completed = 0;
+
+public:
+	// Called by a worker after it published the results of `cars` more cars
+	void add(std::size_t cars) {
+		{
+			std::lock_guard<std::mutex> lock(progressMutex);
+			completed += cars;
+		}
+		progressed.notify_all();
+	}
+
+	// Block until at least `total` cars have been published
+	void waitFor(std::size_t total) {
+		std::unique_lock<std::mutex> lock(progressMutex);
+		progressed.wait(lock, [&] { return completed >= total; });
+	}
+};
+
+
+#endif /* BATCH_PROGRESS_HPP */
@@ -0,0 +1,568 @@
+// Microbenchmark suite for the car pipeline.
+//
+// Groups:
+//   sha1      SHA-1 throughput across message sizes, and SHA1::from_file on a temporary file (MB/s)
+//   monitor   DataMonitor add/remove handoffs per second across 1..N consumers, for the original
+//             single-condition monitor and the current one (park, spin and adaptive waiting), and
+//             round-robin handoffs to one SpscCarQueue per consumer, with context switches per item
+//   parse     JSON parse throughput on generated car documents (MB/s)
+//   result    ResultMonitor insert + final sort cost versus result size (ns per car)
+//   pipeline  End-to-end records per second through CarPipeline (submit and drain on a warm worker
+//             pool) across worker counts, wait policies, top-K, a warm digest memo and dispatch modes
+//
+// Every case runs its warm-up repetitions first and then the measured ones; the table shows the
+// median, min and max. --json FILE writes every sample for regression tracking.
+//
+// Usage: benchmark [--group NAME] [--reps N] [--warmup N] [--threads N] [--quick] [--json FILE]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "car.hpp"
+#include "car_generator.hpp"
+#include "car_io.hpp"
+#include "car_pipeline.hpp"
+#include "data_monitor.hpp"
+#include "json.hpp"
+#include "result_monitor.hpp"
+#include "sha1.hpp"
+#include "spsc_queue.hpp"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+
+// Benchmark settings
+struct BenchmarkOptions {
+	string group;
+	int reps = 5;
+	int warmup = 1;
+	int threads = max(1, int(thread::hardware_concurrency()));
+	bool quick = false;
+	string jsonPath;
+};
+
+// Samples of one benchmark case
+struct BenchmarkResult {
+	string group;
+	string name;
+	string unit;
+	vector<double> samples;
+	json params;
+	double switchesPerItem = -1;
+
+	double median() const {
+		vector<double> sorted = samples;
+		sort(sorted.begin(), sorted.end());
+		size_t middle = sorted.size() / 2;
+		return sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+	}
+};
+
+// A deque, so the reference runCase() returns stays valid while later cases are added
+deque<BenchmarkResult> results;
+
+// Voluntary + involuntary context switches of the whole process so far, or -1 if unknown
+long long contextSwitches() {
+#ifndef _WIN32
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw + usage.ru_nivcsw;
+#else
+	return -1;
+#endif
+}
+
+// Run one case: fn() does one repetition and returns its throughput in `unit`
+template <class Fn>
+BenchmarkResult& runCase(const BenchmarkOptions& options, const string& group, const string& name, const string& unit, json params, Fn fn) {
+	for (int i = 0; i < options.warmup; i++) {
+		fn();
+	}
+
+	BenchmarkResult result;
+	result.group = group;
+	result.name = name;
+	result.unit = unit;
+	result.params = params;
+	for (int i = 0; i < options.reps; i++) {
+		result.samples.push_back(fn());
+	}
+
+	cout << " " << left << setw(10) << group << setw(30) << name << right
+		<< fixed << setprecision(2)
+		<< setw(16) << result.median()
+		<< setw(16) << *min_element(result.samples.begin(), result.samples.end())
+		<< setw(16) << *max_element(result.samples.begin(), result.samples.end())
+		<< "  " << unit << endl;
+	results.push_back(result);
+	return results.back();
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Deterministic cars from the dataset generator
+vector<Car> makeCars(size_t count, unsigned seed) {
+	CarGeneratorConfig config;
+	config.seed = seed;
+	return CarGenerator(config).next(count);
+}
+
+// The same JSON document layout the generator writes
+string carsToJson(const vector<Car>& cars) {
+	ostringstream document;
+	document << "{\n  \"cars\": [\n";
+	for (size_t i = 0; i < cars.size(); i++) {
+		document << "    ";
+		writeCarJson(document, cars[i]);
+		document << (i + 1 < cars.size() ? ",\n" : "\n");
+	}
+	document << "  ]\n}\n";
+	return document.str();
+}
+
+
+void benchmarkSha1(const BenchmarkOptions& options) {
+	for (size_t size : { size_t(16), size_t(64), size_t(1024), size_t(64 * 1024), size_t(1024 * 1024) }) {
+		string message(size, 'x');
+		size_t totalBytes = options.quick ? (size_t(8) << 20) : (size_t(64) << 20);
+		size_t iterations = max(size_t(1), totalBytes / size);
+		runCase(options, "sha1", to_string(size) + " B", "MB/s", { { "bytes", size } }, [&] {
+			auto start = chrono::steady_clock::now();
+			string digest;
+			for (size_t i = 0; i < iterations; i++) {
+				SHA1 sha1;
+				sha1.update(message);
+				digest = sha1.final();
+			}
+			return double(iterations * size) / 1e6 / secondsSince(start);
+		});
+	}
+
+	// File fingerprinting as the result cache does it; the file is in the page cache after warm-up
+	size_t fileBytes = options.quick ? (size_t(64) << 20) : (size_t(512) << 20);
+	string filePath = "benchmark_sha1.tmp";
+	{
+		ofstream file(filePath, ios::binary);
+		string chunk(1 << 20, 'x');
+		for (size_t written = 0; written < fileBytes; written += chunk.size()) {
+			file.write(chunk.data(), chunk.size());
+		}
+	}
+	runCase(options, "sha1", "from_file " + to_string(fileBytes >> 20) + " MiB", "MB/s", { { "bytes", fileBytes } }, [&] {
+		auto start = chrono::steady_clock::now();
+		string digest = SHA1::from_file(filePath);
+		return double(fileBytes) / 1e6 / secondsSince(start);
+	});
+	remove(filePath.c_str());
+}
+
+
+// The DataMonitor as it was before notFull/notEmpty, without the per-item output
+class LegacyDataMonitor {
+private:
+	array<Car, 16> dataBuffer;
+	int count = 0;
+	condition_variable dataCondition;
+	mutex monitorMutex;
+
+public:
+	void add(Car newCar) {
+		unique_lock<mutex> lock(monitorMutex);
+		dataCondition.wait(lock, [this] { return count < 16; });
+		dataBuffer[count++] = newCar;
+		dataCondition.notify_all();
+	}
+
+	Car remove() {
+		unique_lock<mutex> lock(monitorMutex);
+		dataCondition.wait(lock, [this] { return count > 0; });
+		Car car = dataBuffer[--count];
+		dataCondition.notify_all();
+		return car;
+	}
+};
+
+// The old monitor is stopped with one stop car (power == -1) per consumer
+void consumeAll(LegacyDataMonitor& monitor) {
+	while (monitor.remove().power != -1) {
+	}
+}
+
+void finishInput(LegacyDataMonitor& monitor, int consumers) {
+	Car stopCar;
+	stopCar.power = -1;
+	for (int i = 0; i < consumers; i++) {
+		monitor.add(stopCar);
+	}
+}
+
+// The current monitor is closed and drained
+void consumeAll(DataMonitor& monitor) {
+	Car car;
+	while (monitor.remove(car)) {
+	}
+}
+
+void finishInput(DataMonitor& monitor, int) {
+	monitor.close();
+}
+
+DataMonitor* createMonitor(DataMonitor*, WaitPolicy policy) {
+	DataMonitor* monitor = new DataMonitor();
+	monitor->logging = false;
+	monitor->setWaitPolicy(policy);
+	return monitor;
+}
+
+LegacyDataMonitor* createMonitor(LegacyDataMonitor*, WaitPolicy) {
+	return new LegacyDataMonitor();
+}
+
+// One producer hands `items` cars to `consumers` threads; returns handoffs per second
+template <class Monitor>
+double monitorHandoffs(int items, int consumers, long long& switches, WaitPolicy policy = WaitPolicy::Park) {
+	unique_ptr<Monitor> monitor(createMonitor((Monitor*)nullptr, policy));
+	long long switchesBefore = contextSwitches();
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> threads;
+	for (int i = 0; i < consumers; i++) {
+		threads.emplace_back([&monitor] { consumeAll(*monitor); });
+	}
+	Car car;
+	car.make = "Volvo";
+	car.consumption = 5.2;
+	car.power = 100;
+	for (int i = 0; i < items; i++) {
+		monitor->add(car);
+	}
+	finishInput(*monitor, consumers);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	double seconds = secondsSince(start);
+	switches = switchesBefore >= 0 ? contextSwitches() - switchesBefore : -1;
+	return items / seconds;
+}
+
+// The same handoffs dealt round-robin to one SpscCarQueue per consumer
+double spscHandoffs(int items, int consumers, long long& switches) {
+	vector<unique_ptr<SpscCarQueue>> queues;
+	for (int i = 0; i < consumers; i++) {
+		queues.push_back(make_unique<SpscCarQueue>(16));
+	}
+	long long switchesBefore = contextSwitches();
+	auto start = chrono::steady_clock::now();
+
+	vector<thread> threads;
+	for (int i = 0; i < consumers; i++) {
+		threads.emplace_back([&queues, i] {
+			Car car;
+			while (queues[i]->pop(car)) {
+			}
+		});
+	}
+	Car car;
+	car.make = "Volvo";
+	car.consumption = 5.2;
+	car.power = 100;
+	for (int i = 0; i < items; i++) {
+		queues[i % consumers]->push(car);
+	}
+	for (auto& queue : queues) {
+		queue->close();
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	double seconds = secondsSince(start);
+	switches = switchesBefore >= 0 ? contextSwitches() - switchesBefore : -1;
+	return items / seconds;
+}
+
+void benchmarkMonitor(const BenchmarkOptions& options) {
+	int items = options.quick ? 20000 : 200000;
+	for (int consumers = 1; consumers <= options.threads; consumers *= 2) {
+		long long switches = 0;
+		long long totalSwitches = 0;
+		auto& legacy = runCase(options, "monitor", "legacy x" + to_string(consumers), "ops/s", { { "consumers", consumers }, { "items", items } }, [&] {
+			double rate = monitorHandoffs<LegacyDataMonitor>(items, consumers, switches);
+			totalSwitches += switches;
+			return rate;
+		});
+		legacy.switchesPerItem = switches < 0 ? -1 : double(totalSwitches) / items / (options.reps + options.warmup);
+
+		totalSwitches = 0;
+		auto& current = runCase(options, "monitor", "DataMonitor x" + to_string(consumers), "ops/s", { { "consumers", consumers }, { "items", items } }, [&] {
+			double rate = monitorHandoffs<DataMonitor>(items, consumers, switches);
+			totalSwitches += switches;
+			return rate;
+		});
+		current.switchesPerItem = switches < 0 ? -1 : double(totalSwitches) / items / (options.reps + options.warmup);
+
+		if (legacy.switchesPerItem >= 0) {
+			cout << "            context switches per item: legacy " << setprecision(3) << legacy.switchesPerItem
+				<< ", DataMonitor " << current.switchesPerItem << endl;
+		}
+
+		// The same handoffs with spinning waiters, trading CPU for wake-up latency
+		for (WaitPolicy policy : { WaitPolicy::Spin, WaitPolicy::Adaptive }) {
+			totalSwitches = 0;
+			string name = string("DataMonitor ") + waitPolicyName(policy) + " x" + to_string(consumers);
+			auto& spinning = runCase(options, "monitor", name, "ops/s", { { "consumers", consumers }, { "items", items }, { "wait", waitPolicyName(policy) } }, [&] {
+				double rate = monitorHandoffs<DataMonitor>(items, consumers, switches, policy);
+				totalSwitches += switches;
+				return rate;
+			});
+			spinning.switchesPerItem = switches < 0 ? -1 : double(totalSwitches) / items / (options.reps + options.warmup);
+		}
+
+		totalSwitches = 0;
+		auto& spsc = runCase(options, "monitor", "SpscCarQueue round-robin x" + to_string(consumers), "ops/s", { { "consumers", consumers }, { "items", items }, { "dispatch", "round-robin" } }, [&] {
+			double rate = spscHandoffs(items, consumers, switches);
+			totalSwitches += switches;
+			return rate;
+		});
+		spsc.switchesPerItem = switches < 0 ? -1 : double(totalSwitches) / items / (options.reps + options.warmup);
+	}
+}
+
+
+void benchmarkParse(const BenchmarkOptions& options) {
+	for (size_t count : { size_t(1000), size_t(100000) }) {
+		if (options.quick && count > 1000) {
+			break;
+		}
+		string document = carsToJson(makeCars(count, 42));
+		runCase(options, "parse", to_string(count) + " cars", "MB/s", { { "cars", count }, { "bytes", document.size() } }, [&] {
+			auto start = chrono::steady_clock::now();
+			json parsed = json::parse(document);
+			vector<Car> cars;
+			cars.reserve(count);
+			for (const auto& carData : parsed["cars"]) {
+				Car car;
+				car.make = carData["make"];
+				car.consumption = carData["consumption"];
+				car.power = carData["power"];
+				cars.push_back(car);
+			}
+			return document.size() / 1e6 / secondsSince(start);
+		});
+	}
+}
+
+
+void benchmarkResult(const BenchmarkOptions& options) {
+	SortOrder byMake = { { SortKey::Make, true } };
+	SortOrder byScore = { { SortKey::Score, true } };
+	for (size_t count : { size_t(16), size_t(1000), size_t(100000) }) {
+		if (options.quick && count > 1000) {
+			break;
+		}
+		vector<Car> cars = makeCars(count, 7);
+		for (auto& car : cars) {
+			car.performanceScore = calculatePerformanceScore(car);
+		}
+		for (const auto& order : { byMake, byScore }) {
+			string name = to_string(count) + " by " + describeSortOrder(order);
+			runCase(options, "result", name, "ns/car", { { "cars", count }, { "order", describeSortOrder(order) } }, [&] {
+				ResultMonitor monitor;
+				monitor.configure(order, 0);
+				auto start = chrono::steady_clock::now();
+				for (const auto& car : cars) {
+					monitor.addSorted(car);
+				}
+				monitor.finish();
+				return secondsSince(start) * 1e9 / count;
+			});
+		}
+	}
+}
+
+
+// One dataset through a configured CarPipeline, submitted from this thread; returns records per second
+double pipelineRate(CarPipeline& pipeline, const vector<Car>& cars) {
+	auto start = chrono::steady_clock::now();
+	pipeline.submit(cars);
+	pipeline.drain();
+	return cars.size() / secondsSince(start);
+}
+
+// Run one pipeline case on a pool started once for all repetitions, like the socket server's warm pool.
+// With warmMemo, one untimed pass fills the digest memo first, so every repetition reuses its digests.
+void pipelineCase(const BenchmarkOptions& options, const string& name, json params, const PipelineConfig& config, const vector<Car>& cars, bool warmMemo = false) {
+	CarPipeline pipeline;
+	pipeline.configure(config);
+	if (warmMemo) {
+		pipelineRate(pipeline, cars);
+	}
+	params["cars"] = cars.size();
+	params["workers"] = config.workerThreads;
+	runCase(options, "pipeline", name, "records/s", params, [&] {
+		return pipelineRate(pipeline, cars);
+	});
+}
+
+
+void benchmarkPipeline(const BenchmarkOptions& options) {
+	size_t count = options.quick ? 20000 : 200000;
+	vector<Car> cars = makeCars(count, 11);
+	for (int workers = 1; workers <= options.threads; workers *= 2) {
+		PipelineConfig config;
+		config.workerThreads = workers;
+		pipelineCase(options, to_string(count) + " cars x" + to_string(workers), json::object(), config, cars);
+	}
+
+	// The remaining cases change one setting of the pipeline with every worker
+	PipelineConfig base;
+	base.workerThreads = options.threads;
+	string workers = " x" + to_string(options.threads);
+
+	for (WaitPolicy policy : { WaitPolicy::Spin, WaitPolicy::Adaptive }) {
+		PipelineConfig config = base;
+		config.waitPolicy = policy;
+		pipelineCase(options, string("wait ") + waitPolicyName(policy) + workers, { { "wait", waitPolicyName(policy) } }, config, cars);
+	}
+
+	PipelineConfig topK = base;
+	topK.topK = 100;
+	topK.order = { { SortKey::Score, true } };
+	pipelineCase(options, "top-100 by score" + workers, { { "topK", 100 } }, topK, cars);
+
+	PipelineConfig memo = base;
+	memo.useMemo = true;
+	pipelineCase(options, "warm memo" + workers, { { "memo", true } }, memo, cars, true);
+
+	// The shared DataMonitor against per-worker SPSC queues, with one submitter; "locked" takes the
+	// submit mutex that several submitters would need
+	struct DispatchCase {
+		Dispatch dispatch;
+		bool concurrentSubmit;
+	};
+	const DispatchCase dispatchCases[] = {
+		{ Dispatch::Shared, false },
+		{ Dispatch::RoundRobin, false },
+		{ Dispatch::RoundRobin, true },
+		{ Dispatch::LeastLoaded, false }
+	};
+	for (const auto& dispatchCase : dispatchCases) {
+		PipelineConfig config = base;
+		config.queueOrder = QueueOrder::Fifo;
+		config.dispatch = dispatchCase.dispatch;
+		config.concurrentSubmit = dispatchCase.concurrentSubmit;
+		string name = string(dispatchName(dispatchCase.dispatch)) + (dispatchCase.concurrentSubmit ? " locked" : "") + workers;
+		pipelineCase(options, name, { { "dispatch", dispatchName(dispatchCase.dispatch) }, { "lockedSubmit", dispatchCase.concurrentSubmit } }, config, cars);
+	}
+}
+
+
+bool parseBenchmarkOptions(int argc, char* argv[], BenchmarkOptions& options) {
+	try {
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			if (arg == "--group" && i + 1 < argc) {
+				options.group = argv[++i];
+			}
+			else if (arg == "--reps" && i + 1 < argc) {
+				options.reps = max(1, stoi(argv[++i]));
+			}
+			else if (arg == "--warmup" && i + 1 < argc) {
+				options.warmup = max(0, stoi(argv[++i]));
+			}
+			else if (arg == "--threads" && i + 1 < argc) {
+				options.threads = max(1, stoi(argv[++i]));
+			}
+			else if (arg == "--quick") {
+				options.quick = true;
+			}
+			else if (arg == "--json" && i + 1 < argc) {
+				options.jsonPath = argv[++i];
+			}
+			else {
+				cerr << "Usage: " << argv[0] << " [--group sha1|monitor|parse|result|pipeline] [--reps N] [--warmup N] [--threads N] [--quick] [--json FILE]" << endl;
+				return false;
+			}
+		}
+	}
+	catch (const exception&) {
+		cerr << "Invalid option value." << endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	BenchmarkOptions options;
+	if (!parseBenchmarkOptions(argc, argv, options)) {
+		return 1;
+	}
+
+	cout << " " << left << setw(10) << "group" << setw(30) << "case" << right
+		<< setw(16) << "median" << setw(16) << "min" << setw(16) << "max" << endl;
+
+	struct Group {
+		const char* name;
+		void (*run)(const BenchmarkOptions&);
+	};
+	const Group groups[] = {
+		{ "sha1", benchmarkSha1 },
+		{ "monitor", benchmarkMonitor },
+		{ "parse", benchmarkParse },
+		{ "result", benchmarkResult },
+		{ "pipeline", benchmarkPipeline }
+	};
+	for (const auto& group : groups) {
+		if (options.group.empty() || options.group == group.name) {
+			group.run(options);
+		}
+	}
+
+	if (!options.jsonPath.empty()) {
+		json report;
+		report["reps"] = options.reps;
+		report["warmup"] = options.warmup;
+		report["threads"] = options.threads;
+		report["hardwareConcurrency"] = thread::hardware_concurrency();
+		report["results"] = json::array();
+		for (const auto& result : results) {
+			json entry = {
+				{ "group", result.group },
+				{ "name", result.name },
+				{ "unit", result.unit },
+				{ "median", result.median() },
+				{ "samples", result.samples },
+				{ "params", result.params }
+			};
+			if (result.switchesPerItem >= 0) {
+				entry["contextSwitchesPerItem"] = result.switchesPerItem;
+			}
+			report["results"].push_back(entry);
+		}
+		ofstream reportFile(options.jsonPath);
+		if (!reportFile) {
+			cerr << "Error opening the benchmark report file." << endl;
+			return 1;
+		}
+		reportFile << report.dump(2) << endl;
+	}
+	return 0;
+}
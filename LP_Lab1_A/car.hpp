@@ -0,0 +1,33 @@
+#ifndef CAR_HPP
+#define CAR_HPP
+
+
+#include <string>
+#include "sha1.hpp"
+
+
+// Define the Car struct with additional fields
+struct Car {
+	std::string make;
+	double consumption = 0.0;
+	int power = 0;
+	std::string hashCode;
+	double performanceScore = 0.0;
+};
+
+// Function to calculate the SHA-1 hash code of a car's make, consumption and power
+inline std::string calculateHashCode(const Car& car) {
+	SHA1 sha1;
+	sha1.update(car.make);
+	sha1.update(std::to_string(car.consumption));
+	sha1.update(std::to_string(car.power));
+	return sha1.final();
+}
+
+// Function to calculate the performance score
+inline double calculatePerformanceScore(const Car& car) {
+	return car.power / car.consumption;
+}
+
+
+#endif /* CAR_HPP */
@@ -0,0 +1,157 @@
+#ifndef CAR_GENERATOR_HPP
+#define CAR_GENERATOR_HPP
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "car.hpp"
+
+
+// How a numeric field is drawn
+struct Distribution {
+	enum Kind { Uniform, Normal } kind = Uniform;
+	double a = 0.0; // Uniform: min, Normal: mean
+	double b = 1.0; // Uniform: max, Normal: standard deviation
+};
+
+// Parse "uniform:MIN:MAX" or "normal:MEAN:STDDEV"
+inline bool parseDistribution(const std::string& text, Distribution& distribution) {
+	char kind[16] = { 0 };
+	double a = 0.0;
+	double b = 0.0;
+	if (std::sscanf(text.c_str(), "%15[a-z]:%lf:%lf", kind, &a, &b) != 3) {
+		return false;
+	}
+	std::string name = kind;
+	if (name == "uniform" && a <= b) {
+		distribution = { Distribution::Uniform, a, b };
+		return true;
+	}
+	if (name == "normal" && b >= 0.0) {
+		distribution = { Distribution::Normal, a, b };
+		return true;
+	}
+	return false;
+}
+
+struct CarGeneratorConfig {
+	uint64_t seed = 42;
+	int makes = 16; // Number of distinct makes
+	Distribution power{ Distribution::Uniform, 60, 200 };
+	Distribution consumption{ Distribution::Uniform, 3.5, 9.0 };
+	double selectivity = -1.0; // Fraction of cars with power above minPower; negative: whatever the distribution gives
+	int minPower = 100;
+};
+
+
+// Deterministic, seeded stream of cars. Uses its own generator (splitmix64) and its own uniform
+// and normal transforms instead of <random> distributions, whose output differs between standard
+// libraries, so a seed produces the same file on every platform.
+class CarGenerator {
+private:
+	CarGeneratorConfig config;
+	uint64_t state;
+	std::vector<std::string> makeNames;
+	bool hasSpareNormal = false;
+	double spareNormal = 0.0;
+
+	uint64_t nextBits() {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	// Uniform in [0, 1)
+	double nextUnit() {
+		return double(nextBits() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	// Standard normal (Box-Muller, both values used)
+	double nextNormal() {
+		if (hasSpareNormal) {
+			hasSpareNormal = false;
+			return spareNormal;
+		}
+		double u1 = nextUnit();
+		double u2 = nextUnit();
+		if (u1 < 1e-300) {
+			u1 = 1e-300;
+		}
+		double radius = std::sqrt(-2.0 * std::log(u1));
+		double angle = 6.283185307179586 * u2;
+		spareNormal = radius * std::sin(angle);
+		hasSpareNormal = true;
+		return radius * std::cos(angle);
+	}
+
+	double draw(const Distribution& distribution) {
+		if (distribution.kind == Distribution::Normal) {
+			return distribution.a + distribution.b * nextNormal();
+		}
+		return distribution.a + (distribution.b - distribution.a) * nextUnit();
+	}
+
+	int drawPower() {
+		return std::max(1, int(std::lround(draw(config.power))));
+	}
+
+	// Draw a power on the requested side of the filter; falls back to the nearest value on
+	// that side when the distribution rarely produces one
+	int drawPower(bool passes) {
+		for (int attempt = 0; attempt < 64; attempt++) {
+			int power = drawPower();
+			if ((power > config.minPower) == passes) {
+				return power;
+			}
+		}
+		return passes ? config.minPower + 1 : std::max(1, config.minPower);
+	}
+
+public:
+	explicit CarGenerator(const CarGeneratorConfig& generatorConfig) : config(generatorConfig), state(generatorConfig.seed) {
+		static const char* knownMakes[] = { "Volvo", "Opel", "Toyota", "Ford", "Honda", "BMW", "Mercedes", "Audi",
+			"Nissan", "Hyundai", "Kia", "Chevrolet", "Mazda", "Subaru", "Lexus", "Jeep" };
+		int makes = std::max(1, config.makes);
+		for (int i = 0; i < makes; i++) {
+			if (i < 16) {
+				makeNames.push_back(knownMakes[i]);
+			}
+			else {
+				char name[32];
+				std::snprintf(name, sizeof(name), "Make%06d", i);
+				makeNames.push_back(name);
+			}
+		}
+	}
+
+	Car next() {
+		Car car;
+		car.make = makeNames[size_t(nextBits() % makeNames.size())];
+		if (config.selectivity >= 0.0) {
+			car.power = drawPower(nextUnit() < config.selectivity);
+		}
+		else {
+			car.power = drawPower();
+		}
+		// One decimal place, like the reference data, and never zero
+		car.consumption = std::max(0.1, std::round(draw(config.consumption) * 10.0) / 10.0);
+		return car;
+	}
+
+	std::vector<Car> next(size_t count) {
+		std::vector<Car> cars;
+		cars.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			cars.push_back(next());
+		}
+		return cars;
+	}
+};
+
+
+#endif /* CAR_GENERATOR_HPP */
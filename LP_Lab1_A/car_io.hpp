@@ -0,0 +1,63 @@
+#ifndef CAR_IO_HPP
+#define CAR_IO_HPP
+
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include "car.hpp"
+#include "json.hpp"
+
+
+// Input formats: a JSON document {"cars": [...]} like duomenys.json, or NDJSON with one car per line
+enum class CarFormat { Json, Ndjson };
+
+// NDJSON files are recognised by their .ndjson or .jsonl extension
+inline CarFormat carFormatForPath(const std::string& path) {
+	auto endsWith = [&path](const std::string& suffix) {
+		return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	return endsWith(".ndjson") || endsWith(".jsonl") ? CarFormat::Ndjson : CarFormat::Json;
+}
+
+// Read the input fields of a car from a parsed JSON object
+inline Car carFromJson(const nlohmann::json& carData) {
+	Car car;
+	car.make = carData.at("make");
+	car.consumption = carData.at("consumption");
+	car.power = carData.at("power");
+	return car;
+}
+
+// Every field of a processed car, as stored in the result cache and returned by the server
+inline nlohmann::json processedCarToJson(const Car& car) {
+	return {
+		{ "make", car.make },
+		{ "consumption", car.consumption },
+		{ "power", car.power },
+		{ "hashCode", car.hashCode },
+		{ "performanceScore", car.performanceScore }
+	};
+}
+
+inline Car processedCarFromJson(const nlohmann::json& carData) {
+	Car car = carFromJson(carData);
+	car.hashCode = carData.at("hashCode");
+	car.performanceScore = carData.at("performanceScore");
+	return car;
+}
+
+// Write the input fields of a car as one compact JSON object, without a trailing newline.
+// Written by hand so generating huge files does not build a JSON value per car. Consumption is
+// written with one decimal like the generated data, or with every digit when `exact` is set, so
+// parsing the line gives back the same double (needed when the car is handed to another process).
+inline void writeCarJson(std::ostream& out, const Car& car, bool exact = false) {
+	char consumption[32];
+	std::snprintf(consumption, sizeof(consumption), exact ? "%.17g" : "%.1f", car.consumption);
+	out << "{\"make\": " << nlohmann::json(car.make).dump()
+		<< ", \"consumption\": " << consumption
+		<< ", \"power\": " << car.power << "}";
+}
+
+
+#endif /* CAR_IO_HPP */
@@ -0,0 +1,311 @@
+#ifndef CAR_ORDERING_HPP
+#define CAR_ORDERING_HPP
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "car.hpp"
+
+
+// Fields the result can be ordered by
+enum class SortKey { Make, Score, Power, Consumption, Hash };
+
+// One field of an ordering, e.g. "score:desc"
+struct SortField {
+	SortKey key;
+	bool descending;
+};
+
+// Ordering by several fields, most significant first
+typedef std::vector<SortField> SortOrder;
+
+// Comparator used outside of the final sort (e.g. by the top-K heaps): true when a comes before b
+typedef std::function<bool(const Car& a, const Car& b)> CarOrdering;
+
+
+inline const char* sortKeyName(SortKey key) {
+	switch (key) {
+	case SortKey::Make: return "make";
+	case SortKey::Score: return "score";
+	case SortKey::Power: return "power";
+	case SortKey::Consumption: return "consumption";
+	case SortKey::Hash: return "hash";
+	}
+	return "";
+}
+
+// Parse an ordering such as "make:desc,score:asc". A field without a direction is ascending.
+inline bool parseSortOrder(const std::string& text, SortOrder& order) {
+	SortOrder parsed;
+	std::istringstream fields(text);
+	std::string field;
+	while (std::getline(fields, field, ',')) {
+		std::string name = field;
+		std::string direction = "asc";
+		size_t colon = field.find(':');
+		if (colon != std::string::npos) {
+			name = field.substr(0, colon);
+			direction = field.substr(colon + 1);
+		}
+		if (direction != "asc" && direction != "desc") {
+			return false;
+		}
+
+		SortField sortField{ SortKey::Make, direction == "desc" };
+		if (name == "make") sortField.key = SortKey::Make;
+		else if (name == "score") sortField.key = SortKey::Score;
+		else if (name == "power") sortField.key = SortKey::Power;
+		else if (name == "consumption") sortField.key = SortKey::Consumption;
+		else if (name == "hash") sortField.key = SortKey::Hash;
+		else return false;
+		parsed.push_back(sortField);
+	}
+	if (parsed.empty()) {
+		return false;
+	}
+	order = parsed;
+	return true;
+}
+
+// Canonical text form of an ordering, used in the result cache key
+inline std::string describeSortOrder(const SortOrder& order) {
+	std::string text;
+	for (const auto& field : order) {
+		if (!text.empty()) {
+			text += ',';
+		}
+		text += sortKeyName(field.key);
+		text += field.descending ? ":desc" : ":asc";
+	}
+	return text;
+}
+
+
+// Field accessors, one specialisation per key
+template <SortKey Key> struct SortKeyValue;
+template <> struct SortKeyValue<SortKey::Make> { static const std::string& get(const Car& car) { return car.make; } };
+template <> struct SortKeyValue<SortKey::Score> { static double get(const Car& car) { return car.performanceScore; } };
+template <> struct SortKeyValue<SortKey::Power> { static int get(const Car& car) { return car.power; } };
+template <> struct SortKeyValue<SortKey::Consumption> { static double get(const Car& car) { return car.consumption; } };
+template <> struct SortKeyValue<SortKey::Hash> { static const std::string& get(const Car& car) { return car.hashCode; } };
+
+// Comparator for a single field, fixed at compile time
+template <SortKey Key, bool Descending>
+struct FieldLess {
+	bool operator()(const Car& a, const Car& b) const {
+		if (Descending) {
+			return SortKeyValue<Key>::get(b) < SortKeyValue<Key>::get(a);
+		}
+		return SortKeyValue<Key>::get(a) < SortKeyValue<Key>::get(b);
+	}
+};
+
+// Applied after the requested fields by every ordering, so cars that tie on them still come out in
+// one order whatever the worker interleaving: by hash, then by the input fields (the hash sees the
+// consumption with six decimals only). Cars equal here are the same record.
+struct CarTieBreakLess {
+	bool operator()(const Car& a, const Car& b) const {
+		int byHash = a.hashCode.compare(b.hashCode);
+		if (byHash != 0) {
+			return byHash < 0;
+		}
+		int byMake = a.make.compare(b.make);
+		if (byMake != 0) {
+			return byMake < 0;
+		}
+		if (a.consumption != b.consumption) {
+			return a.consumption < b.consumption;
+		}
+		return a.power < b.power;
+	}
+};
+
+// Lexicographic comparator over several fields, fixed at compile time
+template <class First, class... Rest>
+struct CarLess {
+	bool operator()(const Car& a, const Car& b) const {
+		if (First()(a, b)) {
+			return true;
+		}
+		if (First()(b, a)) {
+			return false;
+		}
+		return CarLess<Rest...>()(a, b);
+	}
+};
+
+template <class Last>
+struct CarLess<Last> {
+	bool operator()(const Car& a, const Car& b) const {
+		return Last()(a, b);
+	}
+};
+
+// Fallback for orderings without a specialisation: walks the fields at run time
+struct RuntimeCarLess {
+	SortOrder order;
+
+	template <class T>
+	static int compareValues(const T& a, const T& b) {
+		return a < b ? -1 : (b < a ? 1 : 0);
+	}
+
+	bool operator()(const Car& a, const Car& b) const {
+		for (const auto& field : order) {
+			int result = 0;
+			switch (field.key) {
+			case SortKey::Make: result = compareValues(a.make, b.make); break;
+			case SortKey::Score: result = compareValues(a.performanceScore, b.performanceScore); break;
+			case SortKey::Power: result = compareValues(a.power, b.power); break;
+			case SortKey::Consumption: result = compareValues(a.consumption, b.consumption); break;
+			case SortKey::Hash: result = compareValues(a.hashCode, b.hashCode); break;
+			}
+			if (result != 0) {
+				return field.descending ? result > 0 : result < 0;
+			}
+		}
+		return CarTieBreakLess()(a, b);
+	}
+};
+
+
+// Call fn with the specialised comparator for the common orderings: any single field, and
+// make/score in either order and direction, each followed by CarTieBreakLess. Returns false when the
+// ordering has no specialisation.
+template <class Fn>
+bool withSpecialisedLess(const SortOrder& order, Fn&& fn) {
+	if (order.size() == 1) {
+		bool desc = order[0].descending;
+		switch (order[0].key) {
+		case SortKey::Make: desc ? fn(CarLess<FieldLess<SortKey::Make, true>, CarTieBreakLess>()) : fn(CarLess<FieldLess<SortKey::Make, false>, CarTieBreakLess>()); return true;
+		case SortKey::Score: desc ? fn(CarLess<FieldLess<SortKey::Score, true>, CarTieBreakLess>()) : fn(CarLess<FieldLess<SortKey::Score, false>, CarTieBreakLess>()); return true;
+		case SortKey::Power: desc ? fn(CarLess<FieldLess<SortKey::Power, true>, CarTieBreakLess>()) : fn(CarLess<FieldLess<SortKey::Power, false>, CarTieBreakLess>()); return true;
+		case SortKey::Consumption: desc ? fn(CarLess<FieldLess<SortKey::Consumption, true>, CarTieBreakLess>()) : fn(CarLess<FieldLess<SortKey::Consumption, false>, CarTieBreakLess>()); return true;
+		case SortKey::Hash: desc ? fn(CarLess<FieldLess<SortKey::Hash, true>, CarTieBreakLess>()) : fn(CarLess<FieldLess<SortKey::Hash, false>, CarTieBreakLess>()); return true;
+		}
+	}
+
+	if (order.size() == 2) {
+		bool firstDesc = order[0].descending;
+		bool secondDesc = order[1].descending;
+		if (order[0].key == SortKey::Make && order[1].key == SortKey::Score) {
+			if (firstDesc && secondDesc) fn(CarLess<FieldLess<SortKey::Make, true>, FieldLess<SortKey::Score, true>, CarTieBreakLess>());
+			else if (firstDesc) fn(CarLess<FieldLess<SortKey::Make, true>, FieldLess<SortKey::Score, false>, CarTieBreakLess>());
+			else if (secondDesc) fn(CarLess<FieldLess<SortKey::Make, false>, FieldLess<SortKey::Score, true>, CarTieBreakLess>());
+			else fn(CarLess<FieldLess<SortKey::Make, false>, FieldLess<SortKey::Score, false>, CarTieBreakLess>());
+			return true;
+		}
+		if (order[0].key == SortKey::Score && order[1].key == SortKey::Make) {
+			if (firstDesc && secondDesc) fn(CarLess<FieldLess<SortKey::Score, true>, FieldLess<SortKey::Make, true>, CarTieBreakLess>());
+			else if (firstDesc) fn(CarLess<FieldLess<SortKey::Score, true>, FieldLess<SortKey::Make, false>, CarTieBreakLess>());
+			else if (secondDesc) fn(CarLess<FieldLess<SortKey::Score, false>, FieldLess<SortKey::Make, true>, CarTieBreakLess>());
+			else fn(CarLess<FieldLess<SortKey::Score, false>, FieldLess<SortKey::Make, false>, CarTieBreakLess>());
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Build a comparator for an ordering, specialised when possible
+inline CarOrdering makeCarOrdering(const SortOrder& order) {
+	CarOrdering ordering;
+	if (!withSpecialisedLess(order, [&](auto less) { ordering = less; })) {
+		ordering = RuntimeCarLess{ order };
+	}
+	return ordering;
+}
+
+
+// Map a numeric key to an unsigned integer with the same ordering
+inline uint64_t radixKey(double value) {
+	if (value == 0.0) {
+		value = 0.0; // -0.0 and 0.0 compare equal
+	}
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+}
+
+inline uint64_t radixKey(int value) {
+	return uint64_t(uint32_t(value) ^ 0x80000000u);
+}
+
+// LSD radix sort on a single numeric field, with runs of equal keys then put in CarTieBreakLess
+// order. Byte passes where every key has the same byte are skipped, so an int field costs at most
+// four passes.
+template <SortKey Key>
+void radixSortCars(std::vector<Car>& cars, bool descending) {
+	struct Entry {
+		uint64_t key;
+		size_t index;
+	};
+
+	std::vector<Entry> entries(cars.size());
+	for (size_t i = 0; i < cars.size(); i++) {
+		uint64_t key = radixKey(SortKeyValue<Key>::get(cars[i]));
+		entries[i] = { descending ? ~key : key, i };
+	}
+
+	std::vector<Entry> scratch(entries.size());
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t counts[257] = { 0 };
+		for (const auto& entry : entries) {
+			counts[((entry.key >> shift) & 0xff) + 1]++;
+		}
+		if (counts[((entries[0].key >> shift) & 0xff) + 1] == entries.size()) {
+			continue;
+		}
+		for (int i = 0; i < 256; i++) {
+			counts[i + 1] += counts[i];
+		}
+		for (const auto& entry : entries) {
+			scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+
+	std::vector<Car> sorted;
+	sorted.reserve(cars.size());
+	for (const auto& entry : entries) {
+		sorted.push_back(std::move(cars[entry.index]));
+	}
+	cars.swap(sorted);
+
+	for (size_t start = 0, end; start < entries.size(); start = end) {
+		for (end = start + 1; end < entries.size() && entries[end].key == entries[start].key; end++) {
+		}
+		if (end - start > 1) {
+			std::sort(cars.begin() + start, cars.begin() + end, CarTieBreakLess());
+		}
+	}
+}
+
+// Sort cars by an ordering. Single numeric fields take the radix path, the other common
+// orderings use a specialised comparator and the rest fall back to the run-time one.
+inline void sortCars(std::vector<Car>& cars, const SortOrder& order) {
+	if (cars.size() < 2) {
+		return;
+	}
+
+	if (order.size() == 1 && cars.size() >= 256) {
+		switch (order[0].key) {
+		case SortKey::Score: radixSortCars<SortKey::Score>(cars, order[0].descending); return;
+		case SortKey::Power: radixSortCars<SortKey::Power>(cars, order[0].descending); return;
+		case SortKey::Consumption: radixSortCars<SortKey::Consumption>(cars, order[0].descending); return;
+		default: break;
+		}
+	}
+
+	if (!withSpecialisedLess(order, [&](auto less) { std::stable_sort(cars.begin(), cars.end(), less); })) {
+		std::stable_sort(cars.begin(), cars.end(), RuntimeCarLess{ order });
+	}
+}
+
+
+#endif /* CAR_ORDERING_HPP */
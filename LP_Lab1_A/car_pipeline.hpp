@@ -0,0 +1,489 @@
+#ifndef CAR_PIPELINE_HPP
+#define CAR_PIPELINE_HPP
+
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batch_progress.hpp"
+#include "car.hpp"
+#include "car_ordering.hpp"
+#include "data_monitor.hpp"
+#include "digest_memo.hpp"
+#include "make_aggregate.hpp"
+#include "perf_counters.hpp"
+#include "profiled_mutex.hpp"
+#include "result_monitor.hpp"
+#include "shm_ring.hpp"
+#include "spsc_queue.hpp"
+#include "stage_stats.hpp"
+#include "top_k.hpp"
+#include "trace_events.hpp"
+
+
+// Settings of a CarPipeline, applied by configure()
+struct PipelineConfig {
+	int workerThreads = 4;
+	std::size_t queueSize = 16;
+	QueueOrder queueOrder = QueueOrder::Lifo;
+	SortOrder order = { { SortKey::Make, true } };
+	std::size_t topK = 0; // 0 keeps every car that passes the filter
+	bool aggregate = false;
+	bool aggregateOnly = false; // Aggregates instead of the per-car listing
+	int minPower = 100; // Cars with more power than this pass the filter
+	bool useMemo = false; // Reuse digests and scores through memo()
+	bool stageStats = false;
+	bool perfCounters = false;
+	bool lockStats = false;
+	bool logging = false; // Print every DataMonitor add and remove
+	WaitPolicy waitPolicy = WaitPolicy::Park; // How workers wait on an empty DataMonitor and submit() on a full one
+	Dispatch dispatch = Dispatch::Shared; // Per-worker queues (queueSize cars each) instead of one DataMonitor
+	bool concurrentSubmit = false; // Several threads may call submit() at once; only matters with a per-worker dispatch
+#ifdef __linux__
+	ShmCarRing* ring = nullptr; // Workers take cars straight from this ring instead of submit(); collect with finish()
+#endif
+};
+
+// The outcome of one dataset: the cars that passed the filter in the configured order, and per-make aggregates
+struct PipelineResult {
+	std::vector<Car> cars;
+	MakeAggregates aggregates;
+	std::size_t received = 0;
+};
+
+// The car pipeline as a reusable object: DataMonitor -> hash/score/filter workers -> ResultMonitor.
+// configure() starts the worker pool, submit() queues cars (see below for several submitting threads), and drain() waits for
+// every submitted car and returns the dataset's result. The workers stay up between datasets, so a
+// caller can run many datasets through one pool; shutdown() (or the destructor) stops them.
+//
+// Workers keep their results (top-K heap, aggregates, memo entries) locally. drain() asks them to
+// publish: each worker does so once the queue is empty, and drain() waits until every submitted car
+// has been published. Between drains the workers merge nothing, as in a one-shot run.
+//
+// With a per-worker dispatch, submit() hands each car to one worker's SpscCarQueue instead of the shared
+// DataMonitor; the workers then take cars without any shared lock. Each queue has a single producer, so
+// submit() must then be called from one thread at a time, unless PipelineConfig::concurrentSubmit is
+// set, which serialises the submitters on a mutex of their own. Per-worker queues are always FIFO.
+//
+// With PipelineConfig::ring set, the workers pop cars from a shared-memory ring filled by another
+// process instead; finish() then waits for the producer to close the ring and returns the result.
+class CarPipeline {
+private:
+	PipelineConfig config;
+	DataMonitor dataMonitor;
+	ResultMonitor resultMonitor;
+	DigestMemo digestMemo;
+	BatchProgress batchProgress;
+	StageStats stageStats;
+	PerfReport perfReport;
+	std::vector<std::thread> workers;
+	std::atomic<std::size_t> submittedCars{ 0 };
+	std::size_t drainedCars = 0;
+	std::atomic<bool> drainRequested{ false };
+	std::atomic<std::size_t> ringCars{ 0 };
+	std::vector<std::unique_ptr<SpscCarQueue>> workerQueues; // Empty with Dispatch::Shared
+	std::mutex dispatchMutex; // Makes concurrent submitters one producer for the SPSC queues
+	std::size_t nextQueue = 0;
+
+	// Pick the queue for the next car; called by one submitter at a time. Least-loaded dealing stays
+	// round-robin while the next queue is less than half full and only then looks for the shortest one:
+	// always chasing the shortest queue sends nearly every car to an idle, sleeping worker.
+	SpscCarQueue& chooseQueue() {
+		std::size_t chosen = nextQueue;
+		if (config.dispatch == Dispatch::LeastLoaded) {
+			std::size_t chosenSize = workerQueues[chosen]->size();
+			for (std::size_t i = 1; i < workerQueues.size() && chosenSize * 2 >= config.queueSize; i++) {
+				std::size_t candidate = (nextQueue + i) % workerQueues.size();
+				std::size_t size = workerQueues[candidate]->size();
+				if (size < chosenSize) {
+					chosen = candidate;
+					chosenSize = size;
+				}
+			}
+		}
+		nextQueue = (chosen + 1) % workerQueues.size();
+		return *workerQueues[chosen];
+	}
+
+	void workerLoop(int workerNumber) {
+		std::vector<DigestMemo::Entry> seenEntries;
+		bool topKMode = config.topK > 0;
+		TopKHeap localTopK(config.topK, config.order);
+		MakeAggregates localAggregates;
+		StageRecorder recorder;
+		TraceLog::instance().setThreadName("WorkerThread " + std::to_string(workerNumber));
+		std::unique_ptr<PerfRecorder> perf;
+		if (config.perfCounters) {
+			perf = std::make_unique<PerfRecorder>();
+		}
+
+		// Hand the local results to the shared monitors and start over with empty ones
+		auto publishLocalResults = [&] {
+			if (config.useMemo) {
+				digestMemo.merge(seenEntries);
+				seenEntries.clear();
+			}
+			if (topKMode) {
+				resultMonitor.mergeTopK(localTopK.items());
+				localTopK = TopKHeap(config.topK, config.order);
+			}
+			if (config.aggregate) {
+				resultMonitor.mergeAggregates(localAggregates);
+				localAggregates.clear();
+			}
+		};
+
+		// Take cars until the monitor is closed and drained
+		Car car;
+		long long queuedNanos = 0;
+		std::size_t unpublishedCars = 0;
+		std::size_t ringReceived = 0;
+
+		// The worker's own queue with a per-worker dispatch, otherwise the shared DataMonitor
+		SpscCarQueue* ownQueue = workerQueues.empty() ? nullptr : workerQueues[workerNumber - 1].get();
+		auto currentWakeGeneration = [&] {
+			return ownQueue ? ownQueue->getWakeGeneration() : dataMonitor.getWakeGeneration();
+		};
+		auto tryTake = [&] {
+			return ownQueue ? ownQueue->tryPop(car, &queuedNanos) : dataMonitor.tryRemove(car, &queuedNanos);
+		};
+		auto take = [&](const unsigned* seenWakeGeneration) {
+			return ownQueue ? ownQueue->pop(car, &queuedNanos, seenWakeGeneration) : dataMonitor.remove(car, &queuedNanos, seenWakeGeneration);
+		};
+		auto inputClosed = [&] {
+			return ownQueue ? ownQueue->isClosed() : dataMonitor.isClosed();
+		};
+
+		while (true) {
+			// Cars come from the shared-memory ring when one is configured, otherwise from the DataMonitor
+			bool fromRing = false;
+#ifdef __linux__
+			if (config.ring) {
+				if (!config.ring->pop(car)) {
+					break; // Closed by the producer and empty
+				}
+				fromRing = true;
+				ringReceived++;
+			}
+#endif
+			if (!fromRing) {
+				// The generation is read before drainRequested, so a drain() that starts in between wakes the wait below
+				unsigned wakeGeneration = currentWakeGeneration();
+				if (unpublishedCars > 0 && drainRequested) {
+					// A drain is waiting: publish instead of blocking once the queue is empty
+					if (!tryTake()) {
+						publishLocalResults();
+						batchProgress.add(unpublishedCars);
+						unpublishedCars = 0;
+						continue;
+					}
+				}
+				else if (!take(&wakeGeneration)) {
+					if (inputClosed()) {
+						break;
+					}
+					continue; // Woken by drain()
+				}
+				unpublishedCars++;
+			}
+
+			// The clock is only read with stage statistics on
+			std::optional<StageTimer> timer;
+			if (config.stageStats) {
+				timer.emplace();
+				if (!fromRing) {
+					recorder.record(Stage::QueueWait, uint64_t(queuedNanos));
+				}
+			}
+
+			// Reuse the digest and score of an unchanged record from an earlier run
+			std::string memoKey;
+			bool reused = false;
+			if (config.useMemo) {
+				memoKey = DigestMemo::makeKey(car);
+				reused = digestMemo.lookup(memoKey, car);
+			}
+
+			if (!reused) {
+				// Calculate SHA-1 hash for car data
+				TraceSpan hashSpan("hash", &car.make);
+				PerfRecorder::Scope hashCounters(perf.get(), PerfRegion::Hash);
+				car.hashCode = calculateHashCode(car);
+			}
+			if (timer) {
+				timer->lap(recorder, Stage::Hash);
+			}
+
+			// Calculate the performance score and check if the car meets the filter criteria
+			bool passes;
+			{
+				TraceSpan scoreSpan("score", &car.make);
+				if (!reused) {
+					PerfRecorder::Scope scoreCounters(perf.get(), PerfRegion::Score);
+					car.performanceScore = calculatePerformanceScore(car);
+				}
+				passes = car.power > config.minPower;
+			}
+			if (config.useMemo) {
+				seenEntries.push_back({ memoKey, car.hashCode, car.performanceScore });
+			}
+			if (timer) {
+				timer->lap(recorder, Stage::ScoreFilter);
+			}
+			if (!passes) {
+				continue;
+			}
+
+			if (config.aggregate) {
+				localAggregates[car.make].add(car);
+			}
+
+			// Add the result into the result monitor
+			if (!config.aggregateOnly) {
+				PerfRecorder::Scope insertCounters(perf.get(), PerfRegion::AddSorted);
+				if (topKMode) {
+					localTopK.push(car);
+				}
+				else {
+					resultMonitor.addSorted(car);
+				}
+			}
+			if (timer) {
+				timer->lap(recorder, Stage::ResultInsert);
+			}
+		}
+
+		publishLocalResults();
+		ringCars += ringReceived;
+		if (config.stageStats) {
+			stageStats.merge(recorder);
+		}
+		if (perf) {
+			perfReport.merge(*perf);
+		}
+	}
+
+public:
+	CarPipeline() = default;
+
+	~CarPipeline() {
+		shutdown();
+	}
+
+	CarPipeline(const CarPipeline&) = delete;
+	CarPipeline& operator=(const CarPipeline&) = delete;
+
+	// Apply the settings and start the workers. A running pool is shut down first, so call drain() before
+	// reconfiguring a pipeline that still has cars in flight.
+	void configure(const PipelineConfig& pipelineConfig) {
+		shutdown();
+		config = pipelineConfig;
+		if (config.workerThreads < 1) {
+			config.workerThreads = 1;
+		}
+		if (config.aggregateOnly) {
+			config.aggregate = true;
+		}
+
+		dataMonitor.configure(config.queueSize, config.queueOrder);
+		dataMonitor.logging = config.logging;
+		dataMonitor.setWaitPolicy(config.waitPolicy);
+		dataMonitor.monitorMutex.setProfiling(config.lockStats, "DataMonitor");
+		workerQueues.clear();
+		nextQueue = 0;
+		if (config.dispatch != Dispatch::Shared) {
+			for (int i = 0; i < config.workerThreads; i++) {
+				workerQueues.push_back(std::make_unique<SpscCarQueue>(config.queueSize, config.waitPolicy));
+			}
+		}
+		resultMonitor.configure(config.order, config.topK);
+		resultMonitor.setLockProfiling(config.lockStats);
+		if (config.useMemo) {
+			digestMemo.enableCarryOver();
+		}
+
+		for (int i = 0; i < config.workerThreads; i++) {
+			workers.emplace_back([this, i] { workerLoop(i + 1); });
+		}
+	}
+
+	const PipelineConfig& getConfig() const {
+		return config;
+	}
+
+	bool isRunning() const {
+		return !workers.empty();
+	}
+
+	// The digest memo; load it before configure() and save it after drain()
+	DigestMemo& memo() {
+		return digestMemo;
+	}
+
+	// Queue a car for the workers. Safe to call from several threads with the shared DataMonitor or with
+	// PipelineConfig::concurrentSubmit. Returns false if the pipeline is not running.
+	bool submit(const Car& car) {
+		if (!isRunning()) {
+			return false;
+		}
+		if (workerQueues.empty()) {
+			if (!dataMonitor.add(car)) {
+				return false;
+			}
+		}
+		else if (config.concurrentSubmit) {
+			std::lock_guard<std::mutex> lock(dispatchMutex);
+			if (!chooseQueue().push(car)) {
+				return false;
+			}
+		}
+		else if (!chooseQueue().push(car)) {
+			return false;
+		}
+		submittedCars++;
+		return true;
+	}
+
+	std::size_t submit(const std::vector<Car>& cars) {
+		std::size_t accepted = 0;
+		for (const auto& car : cars) {
+			accepted += submit(car) ? 1 : 0;
+		}
+		return accepted;
+	}
+
+	// Wait until every car submitted so far has been processed and return the result of this dataset.
+	// Every submit() must have returned before drain() is called. The pipeline is then ready for the next dataset.
+	PipelineResult drain() {
+		std::size_t submitted = submittedCars;
+		drainRequested = true;
+		dataMonitor.wakeConsumers();
+		for (auto& queue : workerQueues) {
+			queue->wake();
+		}
+		batchProgress.waitFor(submitted);
+		drainRequested = false;
+		resultMonitor.finish();
+
+		PipelineResult result;
+		result.cars = resultMonitor.getSortedCars();
+		result.aggregates = resultMonitor.getAggregates();
+		result.received = submitted - drainedCars;
+		drainedCars = submitted;
+
+		// The workers are idle now, so the memo entries of this dataset can become visible to the next one
+		if (config.useMemo) {
+			digestMemo.carryOver();
+		}
+		resultMonitor.reset();
+		return result;
+	}
+
+	// Stop the workers once their input ends and return the result of everything not drained yet. With a
+	// shared-memory ring this waits for the producer to close the ring; otherwise every submit() must have returned.
+	// If the ring's producer exited without closing it, the partial result is dropped unsorted.
+	PipelineResult finish() {
+		PipelineResult result;
+		if (workers.empty()) {
+			return result;
+		}
+		dataMonitor.close();
+		for (auto& queue : workerQueues) {
+			queue->close();
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+#ifdef __linux__
+		if (config.ring && config.ring->isPeerLost()) {
+			drainedCars = submittedCars;
+			ringCars = 0;
+			resultMonitor.reset();
+			return result;
+		}
+#endif
+		resultMonitor.finish();
+		result.cars = resultMonitor.getSortedCars();
+		result.aggregates = resultMonitor.getAggregates();
+		result.received = submittedCars - drainedCars + ringCars.exchange(0);
+		drainedCars = submittedCars;
+		if (config.useMemo) {
+			digestMemo.carryOver();
+		}
+		resultMonitor.reset();
+		return result;
+	}
+
+	// Stop the workers once the queued cars are processed. Results not yet drained are discarded.
+	void shutdown() {
+		if (workers.empty()) {
+			return;
+		}
+		dataMonitor.close();
+		for (auto& queue : workerQueues) {
+			queue->close();
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+		drainedCars = submittedCars;
+		ringCars = 0;
+		resultMonitor.reset();
+	}
+
+	// Statistics: stage latencies and hardware counters are merged when the workers stop
+	StageStats& getStageStats() {
+		return stageStats;
+	}
+
+	PerfReport& getPerfReport() {
+		return perfReport;
+	}
+
+	std::vector<LockStats> getLockStats() {
+		return { dataMonitor.monitorMutex.getStats(), resultMonitor.getLockStats() };
+	}
+
+	// Queue latency over every worker queue; with a per-worker dispatch, read it once the workers have stopped
+	QueueLatencyStats getQueueLatency() {
+		QueueLatencyStats total = dataMonitor.getLatencyStats();
+		for (const auto& queue : workerQueues) {
+			QueueLatencyStats latency = queue->getLatencyStats();
+			total.count += latency.count;
+			total.totalNanos += latency.totalNanos;
+			total.maxNanos = std::max(total.maxNanos, latency.maxNanos);
+		}
+		return total;
+	}
+
+	// Spin, yield and park counts of the workers (consumers) and submitters (producers)
+	WaitStats getConsumerWaitStats() const {
+		return sumWaitStats(dataMonitor.getConsumerWaitStats(), &SpscCarQueue::getConsumerWaitStats);
+	}
+
+	WaitStats getProducerWaitStats() const {
+		return sumWaitStats(dataMonitor.getProducerWaitStats(), &SpscCarQueue::getProducerWaitStats);
+	}
+
+private:
+	WaitStats sumWaitStats(WaitStats total, WaitStats (SpscCarQueue::*queueStats)() const) const {
+		for (const auto& queue : workerQueues) {
+			WaitStats stats = ((*queue).*queueStats)();
+			total.spinHits += stats.spinHits;
+			total.yieldHits += stats.yieldHits;
+			total.parks += stats.parks;
+			total.spinLimit = std::max(total.spinLimit, stats.spinLimit);
+		}
+		return total;
+	}
+};
+
+
+#endif /* CAR_PIPELINE_HPP */
@@ -0,0 +1,210 @@
+// C interface to CarPipeline, built as the car_pipeline shared library
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+#include "car_pipeline.hpp"
+#include "car_pipeline_c.h"
+
+using namespace std;
+
+struct car_pipeline {
+	CarPipeline pipeline;
+	string memoPath;
+
+	// The last drained result and the C views handed out for it
+	PipelineResult result;
+	vector<car_result> cars;
+	vector<string> aggregateMakes;
+	vector<car_make_aggregate> aggregates;
+};
+
+// The error of the calling thread's last API call. Per thread, like errno, so concurrent
+// car_pipeline_submit() calls do not write one string at once.
+static thread_local string lastError;
+
+// Function to run an API call, turning exceptions into an error return
+template <class Fn>
+int guarded(car_pipeline* pipeline, Fn fn) {
+	if (!pipeline) {
+		return -1;
+	}
+	try {
+		lastError.clear();
+		return fn();
+	}
+	catch (const exception& e) {
+		lastError = e.what();
+	}
+	catch (...) {
+		lastError = "unknown error";
+	}
+	return -1;
+}
+
+extern "C" {
+
+void car_pipeline_config_init(car_pipeline_config* config) {
+	if (!config) {
+		return;
+	}
+	PipelineConfig defaults;
+	config->worker_threads = defaults.workerThreads;
+	config->queue_size = defaults.queueSize;
+	config->fifo = 0;
+	config->order = nullptr;
+	config->top_k = 0;
+	config->aggregate = 0;
+	config->aggregate_only = 0;
+	config->min_power = defaults.minPower;
+	config->memo_path = nullptr;
+	config->wait_policy = CAR_PIPELINE_WAIT_PARK;
+	config->dispatch = CAR_PIPELINE_DISPATCH_SHARED;
+}
+
+car_pipeline* car_pipeline_create(void) {
+	try {
+		return new car_pipeline();
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void car_pipeline_destroy(car_pipeline* pipeline) {
+	if (!pipeline) {
+		return;
+	}
+	guarded(pipeline, [&] {
+		pipeline->pipeline.shutdown();
+		if (!pipeline->memoPath.empty()) {
+			pipeline->pipeline.memo().save(pipeline->memoPath);
+		}
+		return 0;
+	});
+	delete pipeline;
+}
+
+int car_pipeline_configure(car_pipeline* pipeline, const car_pipeline_config* config) {
+	return guarded(pipeline, [&] {
+		car_pipeline_config defaults;
+		car_pipeline_config_init(&defaults);
+		const car_pipeline_config& settings = config ? *config : defaults;
+
+		PipelineConfig pipelineConfig;
+		pipelineConfig.concurrentSubmit = true; // car_pipeline_submit() may be called from several threads
+		pipelineConfig.workerThreads = settings.worker_threads;
+		pipelineConfig.queueSize = settings.queue_size;
+		pipelineConfig.queueOrder = settings.fifo ? QueueOrder::Fifo : QueueOrder::Lifo;
+		if (settings.order && !parseSortOrder(settings.order, pipelineConfig.order)) {
+			lastError = string("invalid order: ") + settings.order;
+			return -1;
+		}
+		if (!settings.order && settings.top_k > 0) {
+			pipelineConfig.order = { { SortKey::Score, true } };
+		}
+		pipelineConfig.topK = settings.top_k;
+		pipelineConfig.aggregate = settings.aggregate != 0;
+		pipelineConfig.aggregateOnly = settings.aggregate_only != 0;
+		pipelineConfig.minPower = settings.min_power;
+		if (settings.wait_policy == CAR_PIPELINE_WAIT_SPIN) {
+			pipelineConfig.waitPolicy = WaitPolicy::Spin;
+		}
+		else if (settings.wait_policy == CAR_PIPELINE_WAIT_ADAPTIVE) {
+			pipelineConfig.waitPolicy = WaitPolicy::Adaptive;
+		}
+		else if (settings.wait_policy != CAR_PIPELINE_WAIT_PARK) {
+			lastError = "invalid wait policy";
+			return -1;
+		}
+		if (settings.dispatch == CAR_PIPELINE_DISPATCH_ROUND_ROBIN) {
+			pipelineConfig.dispatch = Dispatch::RoundRobin;
+		}
+		else if (settings.dispatch == CAR_PIPELINE_DISPATCH_LEAST_LOADED) {
+			pipelineConfig.dispatch = Dispatch::LeastLoaded;
+		}
+		else if (settings.dispatch != CAR_PIPELINE_DISPATCH_SHARED) {
+			lastError = "invalid dispatch";
+			return -1;
+		}
+
+		// The memo is read while no worker is running
+		pipeline->pipeline.shutdown();
+		pipeline->memoPath = settings.memo_path ? settings.memo_path : "";
+		pipelineConfig.useMemo = !pipeline->memoPath.empty();
+		if (pipelineConfig.useMemo) {
+			pipeline->pipeline.memo().load(pipeline->memoPath);
+		}
+		pipeline->pipeline.configure(pipelineConfig);
+		return 0;
+	});
+}
+
+int car_pipeline_submit(car_pipeline* pipeline, const car_input* cars, size_t count) {
+	return guarded(pipeline, [&] {
+		if (!cars && count > 0) {
+			lastError = "no cars given";
+			return -1;
+		}
+		for (size_t i = 0; i < count; i++) {
+			Car car;
+			car.make = cars[i].make ? cars[i].make : "";
+			car.consumption = cars[i].consumption;
+			car.power = cars[i].power;
+			if (!pipeline->pipeline.submit(car)) {
+				lastError = "the pipeline is not configured";
+				return -1;
+			}
+		}
+		return 0;
+	});
+}
+
+int car_pipeline_drain(car_pipeline* pipeline) {
+	return guarded(pipeline, [&] {
+		if (!pipeline->pipeline.isRunning()) {
+			lastError = "the pipeline is not configured";
+			return -1;
+		}
+		pipeline->result = pipeline->pipeline.drain();
+
+		pipeline->cars.clear();
+		for (const auto& car : pipeline->result.cars) {
+			pipeline->cars.push_back({ car.make.c_str(), car.consumption, car.power, car.hashCode.c_str(), car.performanceScore });
+		}
+
+		pipeline->aggregateMakes.clear();
+		for (const auto& item : pipeline->result.aggregates) {
+			pipeline->aggregateMakes.push_back(item.first);
+		}
+		sort(pipeline->aggregateMakes.begin(), pipeline->aggregateMakes.end());
+		pipeline->aggregates.clear();
+		for (const auto& make : pipeline->aggregateMakes) {
+			const MakeAggregate& aggregate = pipeline->result.aggregates.at(make);
+			pipeline->aggregates.push_back({ make.c_str(), aggregate.count, aggregate.meanScore(), aggregate.minScore,
+				aggregate.maxScore, aggregate.meanPower(), aggregate.minPower, aggregate.maxPower });
+		}
+		return int(pipeline->cars.size());
+	});
+}
+
+const car_result* car_pipeline_results(const car_pipeline* pipeline, size_t* count) {
+	if (count) {
+		*count = pipeline ? pipeline->cars.size() : 0;
+	}
+	return pipeline && !pipeline->cars.empty() ? pipeline->cars.data() : nullptr;
+}
+
+const car_make_aggregate* car_pipeline_aggregates(const car_pipeline* pipeline, size_t* count) {
+	if (count) {
+		*count = pipeline ? pipeline->aggregates.size() : 0;
+	}
+	return pipeline && !pipeline->aggregates.empty() ? pipeline->aggregates.data() : nullptr;
+}
+
+const char* car_pipeline_last_error(const car_pipeline* pipeline) {
+	return pipeline ? lastError.c_str() : "no pipeline";
+}
+
+}
@@ -0,0 +1,112 @@
+/*
+ * C interface to the car pipeline (car_pipeline.hpp), for calling it in-process from other languages.
+ *
+ * A pipeline is created once, configured (which starts its worker threads) and then used for any
+ * number of datasets: submit the cars of a dataset, drain it, read the results, repeat.
+ * Functions returning int return 0 (or a count) on success and -1 on error; car_pipeline_last_error(),
+ * called on the same thread, then describes the problem. Only car_pipeline_submit() may be called from
+ * several threads at once.
+ */
+
+#ifndef CAR_PIPELINE_C_H
+#define CAR_PIPELINE_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#ifdef CAR_PIPELINE_BUILD
+#define CAR_PIPELINE_API __declspec(dllexport)
+#else
+#define CAR_PIPELINE_API __declspec(dllimport)
+#endif
+#else
+#define CAR_PIPELINE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct car_pipeline car_pipeline;
+
+typedef struct car_pipeline_config {
+	int worker_threads;    /* Worker threads (default 4) */
+	size_t queue_size;     /* DataMonitor capacity (default 16) */
+	int fifo;              /* 1 hands out cars oldest first, 0 newest first (default) */
+	const char* order;     /* Result ordering, e.g. "score:desc,make:asc"; NULL for "make:desc" ("score:desc" with top_k) */
+	size_t top_k;          /* Keep only the first top_k cars of the ordering; 0 keeps every car */
+	int aggregate;         /* Collect per-make aggregates */
+	int aggregate_only;    /* Aggregates instead of the per-car listing */
+	int min_power;         /* Cars with more power than this pass the filter (default 100) */
+	const char* memo_path; /* Digest memo file, loaded by configure and saved by destroy; NULL for none */
+	int wait_policy;       /* CAR_PIPELINE_WAIT_* (default PARK) */
+	int dispatch;          /* CAR_PIPELINE_DISPATCH_* (default SHARED) */
+} car_pipeline_config;
+
+/* How workers wait for cars: block at once, spin briefly first, or spin with an adaptive budget */
+#define CAR_PIPELINE_WAIT_PARK 0
+#define CAR_PIPELINE_WAIT_SPIN 1
+#define CAR_PIPELINE_WAIT_ADAPTIVE 2
+
+/* How submitted cars reach the workers: one shared queue, or a lock-free queue per worker filled in turn or emptiest first */
+#define CAR_PIPELINE_DISPATCH_SHARED 0
+#define CAR_PIPELINE_DISPATCH_ROUND_ROBIN 1
+#define CAR_PIPELINE_DISPATCH_LEAST_LOADED 2
+
+/* One input car */
+typedef struct car_input {
+	const char* make;
+	double consumption;
+	int power;
+} car_input;
+
+/* One car of a drained result; the strings stay valid until the next drain or destroy */
+typedef struct car_result {
+	const char* make;
+	double consumption;
+	int power;
+	const char* hash_code;
+	double performance_score;
+} car_result;
+
+/* Per-make aggregate of a drained result, ordered by make */
+typedef struct car_make_aggregate {
+	const char* make;
+	long long count;
+	double mean_score;
+	double min_score;
+	double max_score;
+	double mean_power;
+	int min_power;
+	int max_power;
+} car_make_aggregate;
+
+/* Fill in the defaults */
+CAR_PIPELINE_API void car_pipeline_config_init(car_pipeline_config* config);
+
+CAR_PIPELINE_API car_pipeline* car_pipeline_create(void);
+
+/* Stop the workers, save the digest memo and free the pipeline */
+CAR_PIPELINE_API void car_pipeline_destroy(car_pipeline* pipeline);
+
+/* Apply the settings and start the workers; drain first if cars are still in flight */
+CAR_PIPELINE_API int car_pipeline_configure(car_pipeline* pipeline, const car_pipeline_config* config);
+
+/* Queue cars of the current dataset */
+CAR_PIPELINE_API int car_pipeline_submit(car_pipeline* pipeline, const car_input* cars, size_t count);
+
+/* Wait for every submitted car and collect the result; returns the number of result cars */
+CAR_PIPELINE_API int car_pipeline_drain(car_pipeline* pipeline);
+
+/* The cars and aggregates of the last drain */
+CAR_PIPELINE_API const car_result* car_pipeline_results(const car_pipeline* pipeline, size_t* count);
+CAR_PIPELINE_API const car_make_aggregate* car_pipeline_aggregates(const car_pipeline* pipeline, size_t* count);
+
+/* Description of the last error on the calling thread, or an empty string; valid until its next call */
+CAR_PIPELINE_API const char* car_pipeline_last_error(const car_pipeline* pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAR_PIPELINE_C_H */
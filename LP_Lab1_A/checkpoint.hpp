@@ -0,0 +1,226 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "car.hpp"
+#include "file_replace.hpp"
+#include "make_aggregate.hpp"
+#include "sha1.hpp"
+
+
+// State of a streamed run over an NDJSON input, enough to continue it after a crash: how far the input
+// has been consumed and the result of everything before that point.
+struct Checkpoint {
+	std::uint64_t inputOffset = 0; // Bytes of complete, processed records
+	std::uint64_t processedCars = 0;
+	std::uint64_t skippedRecords = 0;
+	std::string configKey; // Filter, ordering and top-K settings the result was built with
+	std::string inputDigest; // SHA-1 of the start of the input, to notice a different file
+	std::vector<Car> cars; // Sorted result so far
+	MakeAggregates aggregates;
+};
+
+// Bytes of the input covered by Checkpoint::inputDigest
+constexpr std::uint64_t CHECKPOINT_DIGEST_BYTES = 1 << 20;
+
+// SHA-1 of the first min(offset, CHECKPOINT_DIGEST_BYTES) bytes of a file
+inline std::string checkpointInputDigest(const std::string& path, std::uint64_t offset) {
+	std::ifstream file(path, std::ios::binary);
+	std::string prefix(std::size_t(std::min(offset, CHECKPOINT_DIGEST_BYTES)), '\0');
+	file.read(&prefix[0], std::streamsize(prefix.size()));
+	prefix.resize(std::size_t(file.gcount()));
+	SHA1 sha1;
+	sha1.update(prefix);
+	return sha1.final();
+}
+
+// Checkpoint file layout, in host byte order: "LPCK", version, the fields of Checkpoint with
+// length-prefixed strings and SHA-1 digests packed to 20 bytes, then the SHA-1 of everything before it.
+class CheckpointWriter {
+private:
+	std::string data;
+
+public:
+	template <class T>
+	void put(const T& value) {
+		data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void putString(const std::string& text) {
+		put(std::uint32_t(text.size()));
+		data += text;
+	}
+
+	// A 40-character hex digest as 20 bytes
+	void putDigest(const std::string& hex) {
+		auto nibble = [&](std::size_t i) {
+			char c = i < hex.size() ? hex[i] : '0';
+			return c >= 'a' ? c - 'a' + 10 : c >= 'A' ? c - 'A' + 10 : c - '0';
+		};
+		for (std::size_t i = 0; i < 20; i++) {
+			data += char(nibble(i * 2) << 4 | nibble(i * 2 + 1));
+		}
+	}
+
+	const std::string& bytes() const {
+		return data;
+	}
+};
+
+class CheckpointReader {
+private:
+	const std::string& data;
+	std::size_t position = 0;
+
+public:
+	explicit CheckpointReader(const std::string& bytes) : data(bytes) {}
+
+	template <class T>
+	bool get(T& value) {
+		if (data.size() - position < sizeof(value)) {
+			return false;
+		}
+		std::memcpy(&value, data.data() + position, sizeof(value));
+		position += sizeof(value);
+		return true;
+	}
+
+	bool getString(std::string& text) {
+		std::uint32_t size;
+		if (!get(size) || data.size() - position < size) {
+			return false;
+		}
+		text.assign(data, position, size);
+		position += size;
+		return true;
+	}
+
+	bool getDigest(std::string& hex) {
+		if (data.size() - position < 20) {
+			return false;
+		}
+		static const char digits[] = "0123456789abcdef";
+		hex.clear();
+		for (std::size_t i = 0; i < 20; i++) {
+			unsigned char byte = static_cast<unsigned char>(data[position++]);
+			hex += digits[byte >> 4];
+			hex += digits[byte & 15];
+		}
+		return true;
+	}
+};
+
+constexpr std::uint32_t CHECKPOINT_VERSION = 1;
+
+// Write a checkpoint through replaceFile, so a crash or a failed write leaves the previous one intact
+inline bool saveCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+	CheckpointWriter writer;
+	writer.put(std::uint32_t(0x4B43504C)); // "LPCK"
+	writer.put(CHECKPOINT_VERSION);
+	writer.put(checkpoint.inputOffset);
+	writer.put(checkpoint.processedCars);
+	writer.put(checkpoint.skippedRecords);
+	writer.putString(checkpoint.configKey);
+	writer.putDigest(checkpoint.inputDigest);
+
+	writer.put(std::uint64_t(checkpoint.cars.size()));
+	for (const auto& car : checkpoint.cars) {
+		writer.putString(car.make);
+		writer.put(car.consumption);
+		writer.put(std::int32_t(car.power));
+		writer.putDigest(car.hashCode);
+		writer.put(car.performanceScore);
+	}
+
+	writer.put(std::uint64_t(checkpoint.aggregates.size()));
+	for (const auto& item : checkpoint.aggregates) {
+		const MakeAggregate& aggregate = item.second;
+		writer.putString(item.first);
+		writer.put(std::int64_t(aggregate.count));
+		writer.put(aggregate.scoreSum);
+		writer.put(aggregate.minScore);
+		writer.put(aggregate.maxScore);
+		writer.put(std::int64_t(aggregate.powerSum));
+		writer.put(std::int32_t(aggregate.minPower));
+		writer.put(std::int32_t(aggregate.maxPower));
+	}
+
+	SHA1 sha1;
+	sha1.update(writer.bytes());
+	writer.putDigest(sha1.final());
+
+	return replaceFile(path, writer.bytes(), "checkpoint");
+}
+
+// Read a checkpoint written by saveCheckpoint. Returns false if the file is missing, damaged or from another version.
+inline bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+	std::ifstream checkpointFile(path, std::ios::binary);
+	if (!checkpointFile) {
+		std::cerr << "Error opening the checkpoint file " << path << std::endl;
+		return false;
+	}
+	std::string bytes((std::istreambuf_iterator<char>(checkpointFile)), std::istreambuf_iterator<char>());
+
+	// The trailing digest covers everything before it
+	std::string storedDigest;
+	std::string payload = bytes.size() >= 20 ? bytes.substr(0, bytes.size() - 20) : std::string();
+	std::string trailer = bytes.size() >= 20 ? bytes.substr(bytes.size() - 20) : std::string();
+	SHA1 sha1;
+	sha1.update(payload);
+	CheckpointReader trailerReader(trailer);
+	if (!trailerReader.getDigest(storedDigest) || storedDigest != sha1.final()) {
+		std::cerr << "The checkpoint file " << path << " is damaged." << std::endl;
+		return false;
+	}
+
+	CheckpointReader reader(payload);
+	Checkpoint loaded;
+	std::uint32_t magic = 0;
+	std::uint32_t version = 0;
+	std::uint64_t count = 0;
+	bool ok = reader.get(magic) && magic == 0x4B43504C && reader.get(version) && version == CHECKPOINT_VERSION
+		&& reader.get(loaded.inputOffset) && reader.get(loaded.processedCars) && reader.get(loaded.skippedRecords)
+		&& reader.getString(loaded.configKey) && reader.getDigest(loaded.inputDigest) && reader.get(count);
+	for (std::uint64_t i = 0; ok && i < count; i++) {
+		Car car;
+		std::int32_t power = 0;
+		ok = reader.getString(car.make) && reader.get(car.consumption) && reader.get(power)
+			&& reader.getDigest(car.hashCode) && reader.get(car.performanceScore);
+		car.power = power;
+		loaded.cars.push_back(car);
+	}
+	ok = ok && reader.get(count);
+	for (std::uint64_t i = 0; ok && i < count; i++) {
+		std::string make;
+		MakeAggregate aggregate;
+		std::int64_t aggregateCount = 0;
+		std::int64_t powerSum = 0;
+		std::int32_t minPower = 0;
+		std::int32_t maxPower = 0;
+		ok = reader.getString(make) && reader.get(aggregateCount) && reader.get(aggregate.scoreSum)
+			&& reader.get(aggregate.minScore) && reader.get(aggregate.maxScore) && reader.get(powerSum)
+			&& reader.get(minPower) && reader.get(maxPower);
+		aggregate.count = aggregateCount;
+		aggregate.powerSum = powerSum;
+		aggregate.minPower = minPower;
+		aggregate.maxPower = maxPower;
+		loaded.aggregates[make] = aggregate;
+	}
+	if (!ok) {
+		std::cerr << "The checkpoint file " << path << " has an unsupported format." << std::endl;
+		return false;
+	}
+	checkpoint = std::move(loaded);
+	return true;
+}
+
+
+#endif /* CHECKPOINT_HPP */
@@ -0,0 +1,269 @@
+#ifndef DATA_MONITOR_HPP
+#define DATA_MONITOR_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "car.hpp"
+#include "profiled_mutex.hpp"
+#include "trace_events.hpp"
+#include "wait_policy.hpp"
+
+
+// Order in which DataMonitor hands out queued cars
+enum class QueueOrder {
+	Lifo, // Newest car first: cache-warm, but early cars can wait indefinitely under load
+	Fifo // Oldest car first: queueing latency is bounded by the queue length
+};
+
+// Time cars spent in the DataMonitor between add() and remove()
+struct QueueLatencyStats {
+	long long count = 0;
+	long long totalNanos = 0;
+	long long maxNanos = 0;
+
+	double meanMicros() const {
+		return count > 0 ? totalNanos / 1000.0 / count : 0.0;
+	}
+
+	double maxMicros() const {
+		return maxNanos / 1000.0;
+	}
+};
+
+// Define the DataMonitor class for managing car data.
+// Producers wait on notFull and consumers on notEmpty. An add or remove wakes at most one waiter
+// of the other side, and only when one is actually waiting, so an item no longer wakes every
+// worker and the producer.
+//
+// The buffer is a ring: add() appends at the tail, LIFO mode removes from the tail and FIFO mode
+// from the head. Every car is stamped when it is added so the queueing latency can be measured.
+//
+// Shutdown: close() marks the monitor closed and wakes every waiter. Cars already in the buffer
+// are still handed out; remove() returns false only once the monitor is closed and empty.
+//
+// Waiting follows the WaitPolicy (park by default). With spin or adaptive, a consumer that finds the
+// buffer empty (or a producer that finds it full) first releases the lock and polls an atomic copy of
+// the count before blocking on its condition variable.
+class DataMonitor {
+private:
+	struct Slot {
+		Car car;
+		std::chrono::steady_clock::time_point enqueued;
+	};
+
+	std::vector<Slot> dataBuffer; // Fixed capacity, set at construction
+	int head = 0; // Index of the oldest element
+	int count = 0; // Keeps track of the number of elements in the buffer
+	QueueOrder order = QueueOrder::Lifo;
+	QueueLatencyStats latencyStats;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	int waitingProducers = 0;
+	int waitingConsumers = 0;
+	std::atomic<bool> closed{ false };
+	std::atomic<unsigned> wakeGeneration{ 0 }; // Bumped by wakeConsumers()
+	std::atomic<int> visibleCount{ 0 }; // count, readable without the lock by spinning waiters
+	SpinWaiter consumerWait;
+	SpinWaiter producerWait;
+
+public:
+	ProfiledMutex monitorMutex;
+	bool logging = true; // Print every add and remove
+
+	explicit DataMonitor(std::size_t capacity = 16) : dataBuffer(capacity == 0 ? 1 : capacity) {}
+
+	// Change the capacity and order and reopen a closed monitor; only allowed while no thread is using it
+	void configure(std::size_t capacity, QueueOrder queueOrder) {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		dataBuffer.assign(capacity == 0 ? 1 : capacity, Slot());
+		head = 0;
+		count = 0;
+		visibleCount = 0;
+		closed = false;
+		order = queueOrder;
+		latencyStats = QueueLatencyStats();
+	}
+
+	QueueLatencyStats getLatencyStats() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		return latencyStats;
+	}
+
+	// Stop accepting cars and wake every waiter. Queued cars are still drained by remove().
+	void close() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		closed = true;
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	bool isClosed() const {
+		return closed;
+	}
+
+	// Wake every consumer waiting in remove() with a wake generation, without handing it a car
+	void wakeConsumers() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		wakeGeneration++;
+		notEmpty.notify_all();
+	}
+
+	unsigned getWakeGeneration() const {
+		return wakeGeneration;
+	}
+
+	// Choose how producers and consumers wait; only allowed while no thread is using the monitor
+	void setWaitPolicy(WaitPolicy policy) {
+		consumerWait.setPolicy(policy);
+		producerWait.setPolicy(policy);
+	}
+
+	WaitStats getConsumerWaitStats() const {
+		return consumerWait.getStats();
+	}
+
+	WaitStats getProducerWaitStats() const {
+		return producerWait.getStats();
+	}
+
+	// Add a car into the data buffer. Returns false if the monitor was closed.
+	bool add(Car newCar) {
+		TraceSpan addSpan("DataMonitor::add", &newCar.make);
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		int capacity = int(dataBuffer.size());
+		if (count == capacity && !closed && producerWait.getPolicy() != WaitPolicy::Park) {
+			lock.unlock();
+			producerWait.spinUntil([&] { return visibleCount.load(std::memory_order_relaxed) < capacity || closed; });
+			lock.lock();
+		}
+		if (count == capacity && !closed) {
+			// Producer stall: visible as its own span in the trace
+			TraceSpan stallSpan("DataMonitor full", &newCar.make);
+			while (count == capacity && !closed) {
+				waitingProducers++;
+				monitorMutex.wait(notFull, lock);
+				waitingProducers--;
+			}
+		}
+		if (closed) {
+			return false;
+		}
+		Slot& slot = dataBuffer[(head + count) % dataBuffer.size()];
+		slot.car = std::move(newCar);
+		slot.enqueued = std::chrono::steady_clock::now();
+		count++;
+		visibleCount.store(count, std::memory_order_relaxed);
+		if (waitingConsumers > 0) {
+			notEmpty.notify_one();
+		}
+
+		if (!logging) {
+			return true;
+		}
+
+		// Output when an object is added to DataMonitor
+		//cout << endl;
+		std::cout << "Added car to DataMonitor. Count: " << count << std::endl;
+		//cout << endl;
+
+		// Output when the DataMonitor is full
+		if (count == capacity) {
+			std::cout << "DataMonitor is full. Waiting for space." << std::endl;
+		}
+		return true;
+	}
+
+	// Remove a car from the data buffer. Returns false once the monitor is closed and empty.
+	// If queuedNanos is given it receives the time the car spent in the buffer.
+	// If seenWakeGeneration is given (read with getWakeGeneration() before deciding to wait), it also
+	// returns false without a car once wakeConsumers() has been called since that generation.
+	bool remove(Car& car, long long* queuedNanos = nullptr, const unsigned* seenWakeGeneration = nullptr) {
+		return take(car, queuedNanos, true, seenWakeGeneration);
+	}
+
+	// Like remove(), but returns false at once instead of waiting while the buffer is empty
+	bool tryRemove(Car& car, long long* queuedNanos = nullptr) {
+		return take(car, queuedNanos, false, nullptr);
+	}
+
+	// Get the current count of cars in the data buffer
+	int getCount() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		return count;
+	}
+
+private:
+	bool take(Car& car, long long* queuedNanos, bool waitForCar, const unsigned* seenWakeGeneration) {
+		TraceSpan removeSpan("DataMonitor::remove");
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		auto mustWait = [&] {
+			return waitForCar && count == 0 && !closed && (!seenWakeGeneration || *seenWakeGeneration == wakeGeneration);
+		};
+		if (mustWait() && consumerWait.getPolicy() != WaitPolicy::Park) {
+			// Spin without the lock, so the producer can get in
+			lock.unlock();
+			consumerWait.spinUntil([&] {
+				return visibleCount.load(std::memory_order_relaxed) > 0 || closed
+					|| (seenWakeGeneration && *seenWakeGeneration != wakeGeneration);
+			});
+			lock.lock();
+		}
+		while (mustWait()) {
+			waitingConsumers++;
+			monitorMutex.wait(notEmpty, lock);
+			waitingConsumers--;
+		}
+		if (count == 0) {
+			return false;
+		}
+
+		int index;
+		if (order == QueueOrder::Fifo) {
+			index = head;
+			head = (head + 1) % int(dataBuffer.size());
+		}
+		else {
+			index = (head + count - 1) % int(dataBuffer.size());
+		}
+		count--;
+		visibleCount.store(count, std::memory_order_relaxed);
+		car = std::move(dataBuffer[index].car);
+		removeSpan.setCar(&car.make);
+
+		long long waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - dataBuffer[index].enqueued).count();
+		latencyStats.count++;
+		latencyStats.totalNanos += waited;
+		latencyStats.maxNanos = std::max(latencyStats.maxNanos, waited);
+		if (queuedNanos) {
+			*queuedNanos = waited;
+		}
+		if (waitingProducers > 0) {
+			notFull.notify_one();
+		}
+
+		if (!logging) {
+			return true;
+		}
+
+		std::cout << "Removed car from DataMonitor. Count: " << count << std::endl;
+		//cout << endl;
+
+		// Output when the DataMonitor is empty
+		if (count == 0) {
+			std::cout << "DataMonitor is empty. Waiting for data." << std::endl;
+		}
+
+		return true;
+	}
+};
+
+
+#endif /* DATA_MONITOR_HPP */
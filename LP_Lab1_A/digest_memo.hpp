@@ -0,0 +1,140 @@
+#ifndef DIGEST_MEMO_HPP
+#define DIGEST_MEMO_HPP
+
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "car.hpp"
+#include "file_replace.hpp"
+#include "json.hpp"
+
+
+// Persistent (make, consumption, power) -> (hash code, performance score) table.
+// The table from the previous run is read-only while the workers run, so lookups take no lock;
+// each worker collects the entries it sees locally and merges them once when it finishes.
+class DigestMemo {
+public:
+	struct Entry {
+		std::string key;
+		std::string hashCode;
+		double performanceScore;
+	};
+
+private:
+	std::unordered_map<std::string, Entry> previous;
+	std::unordered_map<std::string, Entry> current;
+	bool carryOverEnabled = false;
+	std::vector<Entry> mergedSinceCarryOver;
+	std::mutex mergeMutex;
+	std::atomic<long long> reusedCount{ 0 };
+	std::atomic<long long> recomputedCount{ 0 };
+
+public:
+	// Build the memo key from the same fields that are hashed. The consumption is written with every
+	// significant digit, so cars that differ in any decimal never share an entry.
+	static std::string makeKey(const Car& car) {
+		char consumption[32];
+		std::snprintf(consumption, sizeof(consumption), "%.17g", car.consumption);
+		return car.make + '\x1f' + consumption + '\x1f' + std::to_string(car.power);
+	}
+
+	// Load the table written by the previous run. A missing file simply means an empty table.
+	bool load(const std::string& path) {
+		std::ifstream memoFile(path);
+		if (!memoFile) {
+			return false;
+		}
+
+		try {
+			nlohmann::json table = nlohmann::json::parse(memoFile);
+			for (const auto& entryData : table.at("entries")) {
+				Entry entry;
+				entry.key = entryData.at("key");
+				entry.hashCode = entryData.at("hashCode");
+				entry.performanceScore = entryData.at("performanceScore");
+				previous[entry.key] = entry;
+			}
+			return true;
+		}
+		catch (const nlohmann::json::exception& e) {
+			std::cerr << "Ignoring corrupt digest memo " << path << ": " << e.what() << std::endl;
+			previous.clear();
+			return false;
+		}
+	}
+
+	// Save every entry seen in this run, so records that disappeared from the input are dropped.
+	// A failed write keeps the previous memo file.
+	bool save(const std::string& path) {
+		std::lock_guard<std::mutex> lock(mergeMutex);
+
+		nlohmann::json table;
+		table["entries"] = nlohmann::json::array();
+		for (const auto& item : current) {
+			table["entries"].push_back({
+				{ "key", item.second.key },
+				{ "hashCode", item.second.hashCode },
+				{ "performanceScore", item.second.performanceScore }
+			});
+		}
+
+		return replaceFile(path, table.dump(), "digest memo");
+	}
+
+	// Fill in hashCode and performanceScore from the previous run. Safe to call from any worker.
+	bool lookup(const std::string& key, Car& car) {
+		auto it = previous.find(key);
+		if (it == previous.end()) {
+			recomputedCount++;
+			return false;
+		}
+		car.hashCode = it->second.hashCode;
+		car.performanceScore = it->second.performanceScore;
+		reusedCount++;
+		return true;
+	}
+
+	// Merge the entries a worker saw into the table for the next run
+	void merge(const std::vector<Entry>& entries) {
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		for (const auto& entry : entries) {
+			current[entry.key] = entry;
+		}
+		if (carryOverEnabled) {
+			mergedSinceCarryOver.insert(mergedSinceCarryOver.end(), entries.begin(), entries.end());
+		}
+	}
+
+	// Remember merged entries for carryOver(); must be called before the workers start
+	void enableCarryOver() {
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		carryOverEnabled = true;
+	}
+
+	// Make the entries merged since the last call visible to lookup(), so a long-running pipeline
+	// reuses them in its next batch. Only allowed while no worker is looking up.
+	void carryOver() {
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		for (const auto& entry : mergedSinceCarryOver) {
+			previous[entry.key] = entry;
+		}
+		mergedSinceCarryOver.clear();
+	}
+
+	long long getReusedCount() const {
+		return reusedCount;
+	}
+
+	long long getRecomputedCount() const {
+		return recomputedCount;
+	}
+};
+
+
+#endif /* DIGEST_MEMO_HPP */
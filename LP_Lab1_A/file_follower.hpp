@@ -0,0 +1,170 @@
+#ifndef FILE_FOLLOWER_HPP
+#define FILE_FOLLOWER_HPP
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+// Reads the records appended to a growing NDJSON file. On Linux an inotify watch wakes the reader as soon
+// as the file is written, moved away or deleted; elsewhere the reader polls at the wait timeout.
+// A file that shrinks, or is replaced by rotation, is read again from its start.
+class FileFollower {
+public:
+	static constexpr std::size_t READ_CHUNK_BYTES = 16 << 20; // At most this much per readNewLines()
+
+private:
+	std::string path;
+	std::uint64_t offset = 0;
+	std::string pending; // An unterminated last line, completed by a later append
+	bool reopen = false;
+#ifdef __linux__
+	int inotifyFd = -1;
+	int watch = -1; // -1 while the file is missing; the reader polls until the watch can be added again
+
+	void addWatch() {
+		if (inotifyFd >= 0) {
+			watch = inotify_add_watch(inotifyFd, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+		}
+	}
+#endif
+
+public:
+	explicit FileFollower(const std::string& filePath) : path(filePath) {
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		addWatch();
+#endif
+	}
+
+	~FileFollower() {
+#ifdef __linux__
+		if (inotifyFd >= 0) {
+			close(inotifyFd);
+		}
+#endif
+	}
+
+	FileFollower(const FileFollower&) = delete;
+	FileFollower& operator=(const FileFollower&) = delete;
+
+	// Append the complete lines written since the last call. Returns false while the file cannot be opened.
+	bool readNewLines(std::vector<std::string>& lines) {
+		if (reopen) {
+			// The file was rotated: start over on whatever now has its name
+			reopen = false;
+			offset = 0;
+			pending.clear();
+		}
+#ifdef __linux__
+		if (watch < 0) {
+			addWatch();
+		}
+#endif
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		file.seekg(0, std::ios::end);
+		std::uint64_t size = std::uint64_t(file.tellg());
+		if (size < offset) {
+			// Truncated
+			offset = 0;
+			pending.clear();
+		}
+		if (size == offset) {
+			return true;
+		}
+
+		std::string chunk(std::size_t(std::min<std::uint64_t>(size - offset, READ_CHUNK_BYTES)), '\0');
+		file.seekg(std::streamoff(offset));
+		file.read(&chunk[0], std::streamsize(chunk.size()));
+		chunk.resize(std::size_t(file.gcount()));
+		offset += chunk.size();
+
+		std::size_t start = 0;
+		for (std::size_t newline = chunk.find('\n'); newline != std::string::npos; newline = chunk.find('\n', start)) {
+			if (pending.empty()) {
+				lines.emplace_back(chunk, start, newline - start);
+			}
+			else {
+				lines.push_back(pending + chunk.substr(start, newline - start));
+				pending.clear();
+			}
+			start = newline + 1;
+		}
+		pending.append(chunk, start, std::string::npos);
+		return true;
+	}
+
+	// Wait up to timeoutMillis for the file to change; returns early when it does
+	void waitForChange(int timeoutMillis) {
+#ifdef __linux__
+		if (inotifyFd >= 0 && watch >= 0) {
+			pollfd descriptor = { inotifyFd, POLLIN, 0 };
+			if (poll(&descriptor, 1, timeoutMillis) > 0) {
+				alignas(inotify_event) char events[4096];
+				ssize_t got;
+				while ((got = read(inotifyFd, events, sizeof(events))) > 0) {
+					for (char* at = events; at < events + got; at += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(at)->len) {
+						const inotify_event* event = reinterpret_cast<inotify_event*>(at);
+						// Events of a watch removed after an earlier rotation are stale
+						if (event->wd == watch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))) {
+							reopen = true;
+						}
+					}
+				}
+				if (reopen && watch >= 0) {
+					inotify_rm_watch(inotifyFd, watch);
+					watch = -1;
+				}
+			}
+			return;
+		}
+		if (inotifyFd >= 0) {
+			// Waiting for a rotated file to reappear
+			timeoutMillis = std::min(timeoutMillis, 100);
+		}
+#endif
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMillis));
+	}
+
+	// Bytes of the file consumed so far
+	std::uint64_t getOffset() const {
+		return offset;
+	}
+
+	// Bytes up to the end of the last complete line returned; where a resumed reader starts
+	std::uint64_t getCompleteOffset() const {
+		return offset - pending.size();
+	}
+
+	// Continue after the first `completeOffset` bytes, e.g. from a checkpoint
+	void resumeAt(std::uint64_t completeOffset) {
+		offset = completeOffset;
+		pending.clear();
+	}
+
+	// At the end of a finite input: hand over a last line that has no newline
+	void takePartialLine(std::vector<std::string>& lines) {
+		if (!pending.empty()) {
+			lines.push_back(pending);
+			pending.clear();
+		}
+	}
+};
+
+
+#endif /* FILE_FOLLOWER_HPP */
@@ -0,0 +1,59 @@
+#ifndef FILE_REPLACE_HPP
+#define FILE_REPLACE_HPP
+
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+// Replace the file at path with contents, so readers see either the old file or the complete new one.
+// The bytes go to a temporary file next to it first, named after this process and a per-process counter,
+// so concurrent runs never write the same temporary file. It is renamed over path only if every byte was
+// written; otherwise it is removed and the old file stays. `what` names the file in error messages.
+inline bool replaceFile(const std::filesystem::path& path, const std::string& contents, const std::string& what,
+	std::ios::openmode mode = std::ios::binary) {
+	static std::atomic<unsigned> tempCounter{ 0 };
+#ifdef _WIN32
+	int processId = _getpid();
+#else
+	int processId = int(getpid());
+#endif
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp." + std::to_string(processId) + "." + std::to_string(tempCounter++);
+
+	std::error_code error;
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::trunc | mode);
+		if (!file) {
+			std::cerr << "Error opening the " << what << " file " << tempPath.string() << std::endl;
+			return false;
+		}
+		file.write(contents.data(), std::streamsize(contents.size()));
+		file.close();
+		if (!file) {
+			std::cerr << "Error writing the " << what << " file " << tempPath.string() << std::endl;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::cerr << "Error replacing the " << what << " file " << path.string() << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+
+#endif /* FILE_REPLACE_HPP */
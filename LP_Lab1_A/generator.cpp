@@ -0,0 +1,181 @@
+// Synthetic car dataset generator for scale testing.
+// Writes a deterministic, seeded dataset in the format the main program reads: a JSON document
+// like duomenys.json, or NDJSON with one car per line. Cars are streamed to the file one at a
+// time, so the size is only limited by disk space. With --shm the cars are pushed into the shared-memory
+// ring of a waiting "LP_Lab1_A --shm NAME" instead (Linux only).
+//
+// Usage: generator --count N [--out FILE | --shm NAME] [--format json|ndjson] [--seed S] [--makes K]
+//                  [--power uniform:MIN:MAX|normal:MEAN:SD] [--consumption uniform:MIN:MAX|normal:MEAN:SD]
+//                  [--selectivity FRACTION]
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "car.hpp"
+#include "car_generator.hpp"
+#include "car_io.hpp"
+#include "shm_ring.hpp"
+
+using namespace std;
+
+struct GeneratorOptions {
+	uint64_t count = 1000;
+	string outputPath;
+	CarFormat format = CarFormat::Json;
+	bool formatGiven = false;
+	string ringName;
+	CarGeneratorConfig config;
+};
+
+const char* generatorUsage = "--count N [--out FILE | --shm NAME] [--format json|ndjson] [--seed S] [--makes K] "
+	"[--power uniform:MIN:MAX|normal:MEAN:SD] [--consumption uniform:MIN:MAX|normal:MEAN:SD] [--selectivity FRACTION]";
+
+bool parseGeneratorOptions(int argc, char* argv[], GeneratorOptions& options) {
+	try {
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			if (arg == "--count" && i + 1 < argc) {
+				options.count = stoull(argv[++i]);
+			}
+			else if (arg == "--out" && i + 1 < argc) {
+				options.outputPath = argv[++i];
+			}
+			else if (arg == "--shm" && i + 1 < argc) {
+				options.ringName = argv[++i];
+			}
+			else if (arg == "--format" && i + 1 < argc && (string(argv[i + 1]) == "json" || string(argv[i + 1]) == "ndjson")) {
+				options.format = string(argv[++i]) == "ndjson" ? CarFormat::Ndjson : CarFormat::Json;
+				options.formatGiven = true;
+			}
+			else if (arg == "--seed" && i + 1 < argc) {
+				options.config.seed = stoull(argv[++i]);
+			}
+			else if (arg == "--makes" && i + 1 < argc) {
+				options.config.makes = stoi(argv[++i]);
+			}
+			else if (arg == "--power" && i + 1 < argc && parseDistribution(argv[i + 1], options.config.power)) {
+				i++;
+			}
+			else if (arg == "--consumption" && i + 1 < argc && parseDistribution(argv[i + 1], options.config.consumption)) {
+				i++;
+			}
+			else if (arg == "--selectivity" && i + 1 < argc) {
+				options.config.selectivity = stod(argv[++i]);
+				if (options.config.selectivity < 0.0 || options.config.selectivity > 1.0) {
+					cerr << "Selectivity must be between 0 and 1." << endl;
+					return false;
+				}
+			}
+			else {
+				cerr << "Usage: " << argv[0] << " " << generatorUsage << endl;
+				return false;
+			}
+		}
+	}
+	catch (const exception&) {
+		cerr << "Invalid option value." << endl;
+		cerr << "Usage: " << argv[0] << " " << generatorUsage << endl;
+		return false;
+	}
+
+	if (options.outputPath.empty()) {
+		options.outputPath = options.format == CarFormat::Ndjson ? "cars.ndjson" : "cars.json";
+	}
+	else if (!options.formatGiven) {
+		options.format = carFormatForPath(options.outputPath);
+	}
+	return true;
+}
+
+// Function to push the generated cars into a consumer's shared-memory ring and close it
+int pushToRing(const GeneratorOptions& options) {
+#ifdef __linux__
+	ShmCarRing ring;
+	if (!ring.attach(options.ringName)) {
+		return 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+	CarGenerator generator(options.config);
+	uint64_t passing = 0;
+	for (uint64_t i = 0; i < options.count; i++) {
+		Car car = generator.next();
+		if (car.power > options.config.minPower) {
+			passing++;
+		}
+		if (!ring.push(car)) {
+			cerr << "Error pushing car " << i << " (" << car.make << ") into the ring"
+				<< (ring.isPeerLost() ? ": the consumer exited." : ".") << endl;
+			ring.close();
+			return 1;
+		}
+	}
+	ring.close();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Pushed " << options.count << " cars into " << options.ringName << " in " << seconds << " s ("
+		<< passing << " pass the power filter)." << endl;
+	return 0;
+#else
+	cerr << "Shared-memory rings are only available on Linux." << endl;
+	return 1;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+	GeneratorOptions options;
+	if (!parseGeneratorOptions(argc, argv, options)) {
+		return 1;
+	}
+	if (!options.ringName.empty()) {
+		return pushToRing(options);
+	}
+
+	ofstream outputFile(options.outputPath, ios::binary);
+	if (!outputFile) {
+		cerr << "Error opening the output file " << options.outputPath << endl;
+		return 1;
+	}
+	vector<char> fileBuffer(1 << 20);
+	outputFile.rdbuf()->pubsetbuf(fileBuffer.data(), streamsize(fileBuffer.size()));
+
+	auto start = chrono::steady_clock::now();
+	CarGenerator generator(options.config);
+	uint64_t passing = 0;
+
+	if (options.format == CarFormat::Json) {
+		outputFile << "{\n  \"cars\": [\n";
+	}
+	for (uint64_t i = 0; i < options.count; i++) {
+		Car car = generator.next();
+		if (car.power > options.config.minPower) {
+			passing++;
+		}
+		if (options.format == CarFormat::Json) {
+			outputFile << "    ";
+			writeCarJson(outputFile, car);
+			outputFile << (i + 1 < options.count ? ",\n" : "\n");
+		}
+		else {
+			writeCarJson(outputFile, car);
+			outputFile << '\n';
+		}
+	}
+	if (options.format == CarFormat::Json) {
+		outputFile << "  ]\n}\n";
+	}
+
+	outputFile.close();
+	if (!outputFile) {
+		cerr << "Error writing the output file " << options.outputPath << endl;
+		return 1;
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Wrote " << options.count << " cars to " << options.outputPath << " in " << seconds << " s ("
+		<< passing << " pass the power filter)." << endl;
+	return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef INPUT_SHARDS_HPP
+#define INPUT_SHARDS_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "sha1.hpp"
+#include "trace_events.hpp"
+
+
+// Sharded input: a feed delivered as a directory or wildcard pattern of JSON/NDJSON files.
+// Shards are fingerprinted and parsed on a small pool of loader threads.
+
+// True if the input names a set of shards rather than one file
+inline bool isShardSpec(const std::string& spec) {
+	std::error_code error;
+	return std::filesystem::is_directory(spec, error) || spec.find_first_of("*?") != std::string::npos;
+}
+
+// Match a file name against a pattern with '*' (any run of characters) and '?' (one character)
+inline bool matchesWildcard(const std::string& name, const std::string& pattern) {
+	size_t n = 0;
+	size_t p = 0;
+	size_t starPattern = std::string::npos;
+	size_t starName = 0;
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+			n++;
+			p++;
+		}
+		else if (p < pattern.size() && pattern[p] == '*') {
+			starPattern = p++;
+			starName = n;
+		}
+		else if (starPattern != std::string::npos) {
+			// Let the last '*' swallow one more character
+			p = starPattern + 1;
+			n = ++starName;
+		}
+		else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*') {
+		p++;
+	}
+	return p == pattern.size();
+}
+
+// Append the files of a shard spec to paths, sorted by path. A directory yields its .json, .ndjson and .jsonl
+// files; a pattern may use wildcards in the file name only (e.g. feeds/day1/part-*.ndjson).
+inline bool expandShardPaths(const std::string& spec, std::vector<std::string>& paths) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	fs::path directory;
+	std::string pattern;
+	if (fs::is_directory(spec, error)) {
+		directory = spec;
+	}
+	else {
+		fs::path specPath(spec);
+		directory = specPath.has_parent_path() ? specPath.parent_path() : fs::path(".");
+		pattern = specPath.filename().string();
+	}
+
+	size_t first = paths.size();
+	fs::directory_iterator entries(directory, error);
+	if (error) {
+		return false;
+	}
+	for (const auto& entry : entries) {
+		if (!entry.is_regular_file(error)) {
+			continue;
+		}
+		std::string name = entry.path().filename().string();
+		std::string extension = entry.path().extension().string();
+		bool wanted = pattern.empty()
+			? extension == ".json" || extension == ".ndjson" || extension == ".jsonl"
+			: matchesWildcard(name, pattern);
+		if (wanted) {
+			paths.push_back(entry.path().string());
+		}
+	}
+	std::sort(paths.begin() + first, paths.end());
+	return true;
+}
+
+// Number of loader threads for a shard count: one per shard, at most one per hardware thread unless requested
+inline unsigned loaderThreadCount(size_t shardCount, unsigned requested) {
+	unsigned threads = requested > 0 ? requested : std::max(1u, std::thread::hardware_concurrency());
+	return unsigned(std::max<size_t>(1, std::min<size_t>(threads, shardCount)));
+}
+
+// Run fn(shardIndex) for every shard on `threads` loader threads. Each thread takes the next
+// unclaimed shard when it finishes one, so a few large shards do not hold up the small ones.
+inline void forEachShard(size_t shardCount, unsigned threads, const std::function<void(size_t)>& fn) {
+	std::atomic<size_t> nextShard{ 0 };
+	std::vector<std::thread> loaders;
+	for (unsigned i = 0; i < threads; i++) {
+		loaders.emplace_back([&, i] {
+			TraceLog::instance().setThreadName("Loader " + std::to_string(i + 1));
+			for (size_t shard = nextShard++; shard < shardCount; shard = nextShard++) {
+				fn(shard);
+			}
+		});
+	}
+	for (auto& loader : loaders) {
+		loader.join();
+	}
+}
+
+// SHA-1 of every shard, computed in parallel, in the order of paths
+inline std::vector<std::string> fingerprintShards(const std::vector<std::string>& paths, unsigned threads) {
+	std::vector<std::string> digests(paths.size());
+	forEachShard(paths.size(), threads, [&](size_t shard) {
+		std::string name = std::filesystem::path(paths[shard]).filename().string();
+		TraceSpan span("fingerprint", &name);
+		digests[shard] = SHA1::from_file(paths[shard]);
+	});
+	return digests;
+}
+
+
+#endif /* INPUT_SHARDS_HPP */
@@ -0,0 +1,108 @@
+#ifndef MAKE_AGGREGATE_HPP
+#define MAKE_AGGREGATE_HPP
+
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include "car.hpp"
+#include "json.hpp"
+
+
+// Per-make count, sum, minimum and maximum of performanceScore and power
+struct MakeAggregate {
+	long long count = 0;
+	double scoreSum = 0.0;
+	double minScore = 0.0;
+	double maxScore = 0.0;
+	long long powerSum = 0;
+	int minPower = 0;
+	int maxPower = 0;
+
+	void add(const Car& car) {
+		if (count == 0) {
+			minScore = maxScore = car.performanceScore;
+			minPower = maxPower = car.power;
+		}
+		else {
+			minScore = std::min(minScore, car.performanceScore);
+			maxScore = std::max(maxScore, car.performanceScore);
+			minPower = std::min(minPower, car.power);
+			maxPower = std::max(maxPower, car.power);
+		}
+		count++;
+		scoreSum += car.performanceScore;
+		powerSum += car.power;
+	}
+
+	void merge(const MakeAggregate& other) {
+		if (other.count == 0) {
+			return;
+		}
+		if (count == 0) {
+			*this = other;
+			return;
+		}
+		count += other.count;
+		scoreSum += other.scoreSum;
+		minScore = std::min(minScore, other.minScore);
+		maxScore = std::max(maxScore, other.maxScore);
+		powerSum += other.powerSum;
+		minPower = std::min(minPower, other.minPower);
+		maxPower = std::max(maxPower, other.maxPower);
+	}
+
+	double meanScore() const {
+		return count > 0 ? scoreSum / count : 0.0;
+	}
+
+	double meanPower() const {
+		return count > 0 ? double(powerSum) / count : 0.0;
+	}
+};
+
+// Aggregates keyed by make
+typedef std::unordered_map<std::string, MakeAggregate> MakeAggregates;
+
+inline void mergeAggregates(MakeAggregates& into, const MakeAggregates& from) {
+	for (const auto& item : from) {
+		into[item.first].merge(item.second);
+	}
+}
+
+inline nlohmann::json aggregatesToJson(const MakeAggregates& aggregates) {
+	nlohmann::json result = nlohmann::json::array();
+	for (const auto& item : aggregates) {
+		const MakeAggregate& aggregate = item.second;
+		result.push_back({
+			{ "make", item.first },
+			{ "count", aggregate.count },
+			{ "scoreSum", aggregate.scoreSum },
+			{ "minScore", aggregate.minScore },
+			{ "maxScore", aggregate.maxScore },
+			{ "powerSum", aggregate.powerSum },
+			{ "minPower", aggregate.minPower },
+			{ "maxPower", aggregate.maxPower }
+		});
+	}
+	return result;
+}
+
+inline MakeAggregates aggregatesFromJson(const nlohmann::json& data) {
+	MakeAggregates aggregates;
+	for (const auto& item : data) {
+		MakeAggregate aggregate;
+		aggregate.count = item.at("count");
+		aggregate.scoreSum = item.at("scoreSum");
+		aggregate.minScore = item.at("minScore");
+		aggregate.maxScore = item.at("maxScore");
+		aggregate.powerSum = item.at("powerSum");
+		aggregate.minPower = item.at("minPower");
+		aggregate.maxPower = item.at("maxPower");
+		aggregates[item.at("make").get<std::string>()] = aggregate;
+	}
+	return aggregates;
+}
+
+
+#endif /* MAKE_AGGREGATE_HPP */
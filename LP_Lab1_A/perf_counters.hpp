@@ -0,0 +1,242 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// Code regions measured with hardware counters
+enum class PerfRegion { Hash, Score, AddSorted, Count };
+
+inline const char* perfRegionName(PerfRegion region) {
+	switch (region) {
+	case PerfRegion::Hash: return "hash";
+	case PerfRegion::Score: return "score";
+	case PerfRegion::AddSorted: return "addSorted";
+	default: return "";
+	}
+}
+
+// Hardware events read together
+enum PerfEvent { PerfCycles, PerfInstructions, PerfCacheMisses, PerfBranchMisses, PerfEventCount };
+
+// Counter totals of one region
+struct PerfTotals {
+	std::array<uint64_t, PerfEventCount> events{};
+	uint64_t records = 0;
+
+	void merge(const PerfTotals& other) {
+		for (int i = 0; i < PerfEventCount; i++) {
+			events[i] += other.events[i];
+		}
+		records += other.records;
+	}
+};
+
+
+// Cycles, instructions, cache misses and branch misses of the calling thread (user space only),
+// opened as one perf_event_open group so all four are read with a single read() call.
+// On other platforms, or when the kernel refuses (perf_event_paranoid, containers), isOpen() is false.
+class PerfCounterGroup {
+private:
+	int fds[PerfEventCount] = { -1, -1, -1, -1 };
+
+public:
+	PerfCounterGroup() {
+#ifdef __linux__
+		const uint64_t configs[PerfEventCount] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES
+		};
+		for (int i = 0; i < PerfEventCount; i++) {
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.disabled = i == 0 ? 1 : 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+			fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+			if (fds[i] < 0) {
+				close();
+				return;
+			}
+		}
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	~PerfCounterGroup() {
+		close();
+	}
+
+	PerfCounterGroup(const PerfCounterGroup&) = delete;
+	PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+	bool isOpen() const {
+		return fds[0] >= 0;
+	}
+
+	// Current value of every counter
+	bool read(std::array<uint64_t, PerfEventCount>& values) const {
+#ifdef __linux__
+		if (!isOpen()) {
+			return false;
+		}
+		uint64_t buffer[1 + PerfEventCount];
+		if (::read(fds[0], buffer, sizeof(buffer)) != ssize_t(sizeof(buffer))) {
+			return false;
+		}
+		for (int i = 0; i < PerfEventCount; i++) {
+			values[i] = buffer[1 + i];
+		}
+		return true;
+#else
+		(void)values;
+		return false;
+#endif
+	}
+
+private:
+	void close() {
+#ifdef __linux__
+		for (int i = PerfEventCount - 1; i >= 0; i--) {
+			if (fds[i] >= 0) {
+				::close(fds[i]);
+				fds[i] = -1;
+			}
+		}
+#endif
+	}
+};
+
+
+// Per-thread counter totals for every region; merged into PerfReport when the thread is done
+class PerfRecorder {
+private:
+	PerfCounterGroup group;
+	std::array<PerfTotals, size_t(PerfRegion::Count)> totals;
+
+public:
+	bool isOpen() const {
+		return group.isOpen();
+	}
+
+	const std::array<PerfTotals, size_t(PerfRegion::Count)>& getTotals() const {
+		return totals;
+	}
+
+	// Reads the counters when constructed and again when destroyed, adding the difference to a region
+	class Scope {
+	private:
+		PerfRecorder* recorder;
+		PerfRegion region;
+		std::array<uint64_t, PerfEventCount> start{};
+
+	public:
+		Scope(PerfRecorder* perfRecorder, PerfRegion perfRegion) : recorder(perfRecorder), region(perfRegion) {
+			if (recorder && !recorder->group.read(start)) {
+				recorder = nullptr;
+			}
+		}
+
+		~Scope() {
+			std::array<uint64_t, PerfEventCount> end;
+			if (recorder && recorder->group.read(end)) {
+				PerfTotals& total = recorder->totals[size_t(region)];
+				for (int i = 0; i < PerfEventCount; i++) {
+					total.events[i] += end[i] - start[i];
+				}
+				total.records++;
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+};
+
+
+// Process-wide totals, reported as IPC and misses per record
+class PerfReport {
+private:
+	std::mutex reportMutex;
+	std::array<PerfTotals, size_t(PerfRegion::Count)> totals;
+	int threads = 0;
+	int unavailableThreads = 0;
+
+public:
+	void merge(const PerfRecorder& recorder) {
+		std::lock_guard<std::mutex> lock(reportMutex);
+		if (!recorder.isOpen()) {
+			unavailableThreads++;
+			return;
+		}
+		threads++;
+		for (size_t i = 0; i < totals.size(); i++) {
+			totals[i].merge(recorder.getTotals()[i]);
+		}
+	}
+
+	void print(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(reportMutex);
+		if (threads == 0) {
+			out << "Hardware counters unavailable (perf_event_open failed or unsupported platform)." << std::endl;
+			return;
+		}
+
+		std::ios_base::fmtflags flags = out.flags();
+		std::streamsize precision = out.precision();
+		out << "Hardware counters over " << threads << " worker threads";
+		if (unavailableThreads > 0) {
+			out << " (" << unavailableThreads << " could not open counters)";
+		}
+		out << ":" << '\n';
+		out << " " << std::left << std::setw(12) << "Region" << std::right
+			<< std::setw(10) << "records"
+			<< std::setw(8) << "IPC"
+			<< std::setw(14) << "cycles/rec"
+			<< std::setw(14) << "instr/rec"
+			<< std::setw(16) << "cache miss/rec"
+			<< std::setw(14) << "br miss/rec" << '\n';
+		for (size_t i = 0; i < totals.size(); i++) {
+			const PerfTotals& total = totals[i];
+			if (total.records == 0) {
+				continue;
+			}
+			double records = double(total.records);
+			double cycles = double(total.events[PerfCycles]);
+			out << " " << std::left << std::setw(12) << perfRegionName(PerfRegion(i)) << std::right
+				<< std::setw(10) << total.records
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(8) << (cycles > 0 ? total.events[PerfInstructions] / cycles : 0.0)
+				<< std::setw(14) << cycles / records
+				<< std::setw(14) << total.events[PerfInstructions] / records
+				<< std::setw(16) << total.events[PerfCacheMisses] / records
+				<< std::setw(14) << total.events[PerfBranchMisses] / records << '\n';
+		}
+		out.flags(flags);
+		out.precision(precision);
+	}
+};
+
+
+#endif /* PERF_COUNTERS_HPP */
@@ -0,0 +1,146 @@
+#ifndef PROCESS_SHARDS_HPP
+#define PROCESS_SHARDS_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <vector>
+#include "car.hpp"
+#include "car_ordering.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+
+// Multi-process execution: the coordinator partitions the cars by make across worker processes,
+// each runs the whole pipeline on its partition, and the coordinator merges their sorted outputs.
+
+// Partition of a make. FNV-1a rather than std::hash, so every process and host agrees on the partition.
+inline std::size_t shardForMake(const std::string& make, std::size_t shards) {
+	std::uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : make) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return std::size_t(hash % shards);
+}
+
+// Merge runs that are each sorted by `ordering` into one sorted list of at most `limit` cars (0 = all).
+// Equal cars keep the order of their runs.
+inline std::vector<Car> mergeSortedRuns(const std::vector<std::vector<Car>>& runs, const CarOrdering& ordering, std::size_t limit = 0) {
+	struct Cursor {
+		std::size_t run;
+		std::size_t index;
+	};
+	auto later = [&](const Cursor& a, const Cursor& b) {
+		const Car& carA = runs[a.run][a.index];
+		const Car& carB = runs[b.run][b.index];
+		if (ordering(carB, carA)) {
+			return true;
+		}
+		return !ordering(carA, carB) && a.run > b.run;
+	};
+	std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heads(later);
+
+	std::size_t total = 0;
+	for (std::size_t run = 0; run < runs.size(); run++) {
+		total += runs[run].size();
+		if (!runs[run].empty()) {
+			heads.push({ run, 0 });
+		}
+	}
+	if (limit > 0 && limit < total) {
+		total = limit;
+	}
+
+	std::vector<Car> merged;
+	merged.reserve(total);
+	while (!heads.empty() && merged.size() < total) {
+		Cursor head = heads.top();
+		heads.pop();
+		merged.push_back(runs[head.run][head.index]);
+		if (++head.index < runs[head.run].size()) {
+			heads.push(head);
+		}
+	}
+	return merged;
+}
+
+#ifndef _WIN32
+// A spawned worker process and the coordinator's end of its socket
+struct WorkerProcess {
+	pid_t pid = -1;
+	int fd = -1;
+};
+
+// Path of the running executable, to start worker processes of the same build
+inline std::string currentExecutablePath(const char* argv0) {
+#ifdef __linux__
+	if (access("/proc/self/exe", X_OK) == 0) {
+		return "/proc/self/exe";
+	}
+#endif
+	return argv0;
+}
+
+// Start `executable args... FD` with a connected Unix socket as FD. Spawn the workers one at a time:
+// the worker's end stays inheritable only until this function closes it.
+inline bool spawnWorkerProcess(const std::string& executable, std::vector<std::string> args, WorkerProcess& worker) {
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0) {
+		std::cerr << "Error creating a worker socket: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+	fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+	args.push_back(std::to_string(sockets[1]));
+
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(executable.c_str()));
+	for (auto& arg : args) {
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	pid_t pid;
+	int error = posix_spawn(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ);
+	close(sockets[1]);
+	if (error != 0) {
+		std::cerr << "Error starting a worker process: " << std::strerror(error) << std::endl;
+		close(sockets[0]);
+		return false;
+	}
+	worker.pid = pid;
+	worker.fd = sockets[0];
+	return true;
+}
+
+// Wait for a worker process to exit. Returns true if it exited with status 0.
+inline bool waitWorkerProcess(WorkerProcess& worker) {
+	if (worker.fd >= 0) {
+		close(worker.fd);
+		worker.fd = -1;
+	}
+	int status = 0;
+	while (waitpid(worker.pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+
+#endif /* PROCESS_SHARDS_HPP */
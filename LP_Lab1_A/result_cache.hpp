@@ -0,0 +1,111 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "car.hpp"
+#include "car_io.hpp"
+#include "file_replace.hpp"
+#include "json.hpp"
+#include "make_aggregate.hpp"
+#include "sha1.hpp"
+
+
+// On-disk cache of sorted results, keyed by the input file digest and the filter configuration.
+// Every entry is a small JSON file <directory>/<key>.json, so it can be inspected or deleted by hand.
+class ResultCache {
+private:
+	std::filesystem::path directory;
+
+	std::filesystem::path entryPath(const std::string& key) const {
+		return directory / (key + ".json");
+	}
+
+public:
+	// Bumped whenever results written by an older build must not be reused
+	static const int formatVersion = 3;
+
+	explicit ResultCache(const std::string& cacheDirectory) : directory(cacheDirectory) {}
+
+	// Build the cache key: SHA-1 of the input file combined with the filter configuration.
+	// Empty if the input could not be hashed; such a run must not use the cache.
+	static std::string makeKey(const std::string& inputPath, const std::string& filterConfig) {
+		std::string inputDigest = SHA1::from_file(inputPath);
+		if (inputDigest.empty()) {
+			return "";
+		}
+		SHA1 sha1;
+		sha1.update(inputDigest);
+		sha1.update(filterConfig);
+		sha1.update(";format=" + std::to_string(formatVersion));
+		return sha1.final();
+	}
+
+	// Build the cache key of a sharded input from the digests of its files, in shard order
+	static std::string makeKey(const std::vector<std::string>& shardDigests, const std::string& filterConfig) {
+		for (const auto& digest : shardDigests) {
+			if (digest.empty()) {
+				return "";
+			}
+		}
+		SHA1 sha1;
+		sha1.update("shards=" + std::to_string(shardDigests.size()) + ";");
+		for (const auto& digest : shardDigests) {
+			sha1.update(digest);
+		}
+		sha1.update(filterConfig);
+		sha1.update(";format=" + std::to_string(formatVersion));
+		return sha1.final();
+	}
+
+	// Load the sorted result and per-make aggregates for a key. Returns false on a miss or an unreadable entry.
+	bool load(const std::string& key, std::vector<Car>& cars, MakeAggregates& aggregates) const {
+		std::ifstream entryFile(entryPath(key));
+		if (!entryFile) {
+			return false;
+		}
+
+		try {
+			nlohmann::json entry = nlohmann::json::parse(entryFile);
+			std::vector<Car> loaded;
+			for (const auto& carData : entry.at("cars")) {
+				loaded.push_back(processedCarFromJson(carData));
+			}
+			aggregates = aggregatesFromJson(entry.value("aggregates", nlohmann::json::array()));
+			cars = std::move(loaded);
+			return true;
+		}
+		catch (const nlohmann::json::exception& e) {
+			std::cerr << "Ignoring corrupt cache entry " << entryPath(key) << ": " << e.what() << std::endl;
+			return false;
+		}
+	}
+
+	// Store the sorted result and per-make aggregates for a key. The entry replaces the old one only once it
+	// was written completely (see replaceFile), so a crash or a full disk never leaves a truncated entry behind.
+	bool store(const std::string& key, const std::vector<Car>& cars, const MakeAggregates& aggregates) const {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error) {
+			std::cerr << "Error creating the cache directory: " << error.message() << std::endl;
+			return false;
+		}
+
+		nlohmann::json entry;
+		entry["cars"] = nlohmann::json::array();
+		for (const auto& car : cars) {
+			entry["cars"].push_back(processedCarToJson(car));
+		}
+
+		entry["aggregates"] = aggregatesToJson(aggregates);
+
+		return replaceFile(entryPath(key), entry.dump(), "cache");
+	}
+};
+
+
+#endif /* RESULT_CACHE_HPP */
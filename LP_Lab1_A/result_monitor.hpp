@@ -0,0 +1,178 @@
+#ifndef RESULT_MONITOR_HPP
+#define RESULT_MONITOR_HPP
+
+
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "car.hpp"
+#include "car_ordering.hpp"
+#include "make_aggregate.hpp"
+#include "profiled_mutex.hpp"
+#include "top_k.hpp"
+#include "trace_events.hpp"
+
+
+// ResultMonitor class for managing processed results
+class ResultMonitor {
+private:
+	std::vector<Car> resultBuffer; // Put in order by finish()
+	ProfiledMutex monitorMutex;
+	SortOrder sortOrder = { { SortKey::Make, true } };
+
+	// Top-K mode: only the first K cars of the ordering are kept, merged from the workers' own heaps
+	std::size_t topK = 0;
+	TopKHeap topKHeap{ 0, sortOrder };
+
+	// Per-make aggregates, merged from the workers' own maps
+	MakeAggregates aggregates;
+
+public:
+	// Turn lock profiling on or off; must be called before the workers start
+	void setLockProfiling(bool enabled) {
+		monitorMutex.setProfiling(enabled, "ResultMonitor");
+	}
+
+	LockStats getLockStats() {
+		return monitorMutex.getStats();
+	}
+
+	// Add a car to the result; the result is put in order once, by finish()
+	void addSorted(Car newCar) {
+		TraceSpan span("ResultMonitor::addSorted", &newCar.make);
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		resultBuffer.push_back(std::move(newCar));
+	}
+
+	// Configure the ordering and top-K mode; must be called before the workers start
+	void configure(const SortOrder& order, std::size_t k) {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		sortOrder = order;
+		topK = k;
+		topKHeap = TopKHeap(k, order);
+	}
+
+	bool isTopK() const {
+		return topK > 0;
+	}
+
+	std::size_t getTopK() const {
+		return topK;
+	}
+
+	const SortOrder& getSortOrder() const {
+		return sortOrder;
+	}
+
+	// Merge a worker's per-make aggregates into the monitor's ones
+	void mergeAggregates(const MakeAggregates& workerAggregates) {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		::mergeAggregates(aggregates, workerAggregates);
+	}
+
+	MakeAggregates getAggregates() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		return aggregates;
+	}
+
+	// Merge a worker's bounded heap into the monitor's one
+	void mergeTopK(const std::vector<Car>& cars) {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		topKHeap.merge(cars);
+	}
+
+	// Put the collected cars in order (or take the merged top-K heap) once the workers are done
+	void finish() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		if (topK > 0) {
+			resultBuffer = topKHeap.sorted();
+		}
+		else {
+			sortCars(resultBuffer, sortOrder);
+		}
+	}
+
+	// Get the sorted cars currently held by the monitor
+	std::vector<Car> getSortedCars() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		return resultBuffer;
+	}
+
+	// Replace the contents with an already sorted result (e.g. loaded from the cache)
+	void loadSorted(const std::vector<Car>& cars, const MakeAggregates& loadedAggregates) {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		resultBuffer = cars;
+		aggregates = loadedAggregates;
+	}
+
+	// Drop the result, top-K heap and aggregates before the next batch of a long-running pipeline
+	void reset() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		resultBuffer.clear();
+		topKHeap = TopKHeap(topK, sortOrder);
+		aggregates.clear();
+	}
+
+	// Get the current count of cars in the result buffer
+	int getCount() {
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+		return int(resultBuffer.size());
+	}
+
+	void printResult(const Car& car, int maxMakeWidth, int maxConsumptionWidth, int maxPowerWidth, bool toConsole = true) {
+		TraceSpan span("ResultMonitor::printResult", &car.make);
+		std::unique_lock<ProfiledMutex> lock(monitorMutex);
+
+		std::string dashHeader = " ----------------------------------------------------------------------------";
+		std::string carHeader = " | Car Data                                                                 |";
+
+		if (toConsole) {
+			std::cout << dashHeader << std::endl;
+			std::cout << carHeader << std::endl;
+			std::cout << dashHeader << std::endl;
+			std::cout << " |" << std::setw(maxMakeWidth) << "Make      " << " |"
+				<< std::setw(maxConsumptionWidth) << " Consumption" << "|"
+				<< std::setw(maxPowerWidth) << "  Power" << "|"
+				<< std::setw(40) << "  Hash Code" << " |" << '\n';
+			std::cout << dashHeader << std::endl;
+			std::cout << " |" << std::setw(maxMakeWidth) << car.make << "  |"
+				<< std::setw(11) << car.consumption << " |"
+				<< std::setw(maxPowerWidth) << car.power << "    |"
+				<< std::setw(40) << car.hashCode << " |" << '\n';
+			std::cout << dashHeader << std::endl;
+
+			// Output what each thread is doing to both console and file
+			//std::cout << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Hash Code: " << car.hashCode << " | Performance Score: " << car.performanceScore << "\n";
+			std::cout << "Performance Score: " << car.performanceScore << "\n";
+		}
+
+		// Output to the result file
+		std::ofstream outputFile("result.txt", std::ios::app); // Open the file in append mode
+		if (outputFile) {
+			outputFile << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Hash Code: " << car.hashCode << " | Performance Score: " << car.performanceScore << "\n";
+			outputFile << dashHeader << std::endl;
+			outputFile << carHeader << std::endl;
+			outputFile << dashHeader << std::endl;
+			outputFile << " |" << std::setw(maxMakeWidth) << "Make      " << " |"
+				<< std::setw(maxConsumptionWidth) << "Consumption " << "|"
+				<< std::setw(maxPowerWidth) << "  Power" << "|"
+				<< std::setw(40) << "  Hash Code" << " |" << '\n';
+			outputFile << dashHeader << std::endl;
+			outputFile << " |" << std::setw(maxMakeWidth) << car.make << "  |"
+				<< std::setw(11) << car.consumption << " |"
+				<< std::setw(maxPowerWidth) << car.power << "    |"
+				<< std::setw(40) << car.hashCode << " |" << '\n';
+			outputFile << dashHeader << std::endl;
+			//outputFile << "Processing: " << car.make << " | Consumption: " << car.consumption << " | Power: " << car.power << " | Performance Score: " << car.performanceScore << "\n";
+			outputFile << "Performance Score: " << car.performanceScore << "\n";
+		}
+		outputFile.close();
+	}
+};
+
+
+#endif /* RESULT_MONITOR_HPP */
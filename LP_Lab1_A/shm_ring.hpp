@@ -0,0 +1,409 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <linux/futex.h>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <thread>
+#include <unistd.h>
+#include "car.hpp"
+
+
+// One car in the ring: a fixed-size binary record, so producers and consumers exchange cars without
+// serialising them. `sequence` belongs to the ring protocol and tells whose turn the slot is.
+struct ShmCarRecord {
+	std::atomic<std::uint64_t> sequence;
+	double consumption;
+	std::int32_t power;
+	std::uint32_t makeLength;
+	char make[40];
+};
+
+static_assert(sizeof(ShmCarRecord) == 64, "a ring record fills one cache line");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+	"ring atomics are shared between processes and must be lock-free");
+
+// Start of the shared segment; the records follow it. Positions and wait words sit on their own cache
+// lines so producers and consumers do not share lines they write.
+struct ShmRingHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t capacity; // Records, a power of two
+	std::uint32_t recordSize;
+	std::atomic<std::uint32_t> ready; // Set once the creator has initialised the segment
+	std::atomic<std::uint32_t> closed; // Set by the producer after its last car
+	std::atomic<std::int32_t> consumerPid; // Set by create()
+	std::atomic<std::int32_t> producerPid; // Set by attach(); 0 until the producer has attached
+	alignas(64) std::atomic<std::uint64_t> enqueuePosition;
+	alignas(64) std::atomic<std::uint64_t> dequeuePosition;
+	alignas(64) std::atomic<std::uint32_t> dataSignal; // Futex word consumers wait on while the ring is empty
+	std::atomic<std::uint32_t> dataWaiters;
+	alignas(64) std::atomic<std::uint32_t> spaceSignal; // Futex word producers wait on while the ring is full
+	std::atomic<std::uint32_t> spaceWaiters;
+};
+
+// Bounded queue of cars in POSIX shared memory (/dev/shm), for handing cars from another process on the
+// same host straight to the workers. Any number of threads may push and pop at once. Slots carry a
+// sequence number (Vyukov's bounded queue), so pushing and popping take one compare-and-swap each. A side
+// that finds the ring empty or full sleeps on a shared futex; the other side only makes the wake-up
+// system call when someone is registered as waiting.
+//
+// The consumer creates the segment and removes its name again when done. One producer process attaches
+// to it, pushes its cars and closes the ring, which ends the stream; attach() refuses a second producer.
+// Both record their process id in the header. Waits are bounded, and a side that times out checks
+// whether the other process still exists, so a peer that dies without closing the ring ends the wait
+// instead of hanging it (see isPeerLost()).
+class ShmCarRing {
+public:
+	static constexpr std::uint32_t MAGIC = 0x4C505352; // "LPSR"
+	static constexpr std::uint32_t VERSION = 2;
+	static constexpr std::uint32_t DEFAULT_CAPACITY = 4096;
+	static constexpr std::size_t MAX_MAKE_LENGTH = sizeof(ShmCarRecord::make);
+	static constexpr long WAIT_SLICE_MILLIS = 100; // Longest single futex wait before the peer is checked
+
+private:
+	std::string name;
+	ShmRingHeader* header = nullptr;
+	ShmCarRecord* records = nullptr;
+	std::size_t mappedBytes = 0;
+	std::uint64_t mask = 0;
+	bool owner = false;
+	std::atomic<bool> peerLost{ false };
+
+	static std::size_t recordsOffset() {
+		return (sizeof(ShmRingHeader) + 63) & ~std::size_t(63);
+	}
+
+	static std::size_t segmentBytes(std::uint32_t capacity) {
+		return recordsOffset() + std::size_t(capacity) * sizeof(ShmCarRecord);
+	}
+
+	// Shared (not process-private) futex operations on a 32-bit word in the segment.
+	// The wait gives up after WAIT_SLICE_MILLIS; returns true if it timed out.
+	static bool futexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+		timespec timeout = { 0, WAIT_SLICE_MILLIS * 1000000 };
+		return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0) < 0
+			&& errno == ETIMEDOUT;
+	}
+
+	static void futexWake(std::atomic<std::uint32_t>& word, int waiters) {
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, waiters, nullptr, nullptr, 0);
+	}
+
+	// Tell the other side that the signal word changed, if anyone is waiting on it
+	static void signal(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiters, int count) {
+		word.fetch_add(1);
+		if (waiters.load() > 0) {
+			futexWake(word, count);
+		}
+	}
+
+	// Sleep until the signal word moves on from the value read before the caller's last attempt, or for
+	// at most WAIT_SLICE_MILLIS. Returns true if retry() succeeded; sets timedOut if the wait ran out.
+	template <class Retry>
+	static bool waitFor(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiters, Retry retry, bool& timedOut) {
+		std::uint32_t seen = word.load();
+		waiters.fetch_add(1);
+		bool done = retry();
+		timedOut = false;
+		if (!done) {
+			timedOut = futexWait(word, seen);
+		}
+		waiters.fetch_sub(1);
+		return done;
+	}
+
+	// Whether the process recorded in a pid field is still running; an unset field counts as running.
+	// A killed process stays a zombie until its parent reaps it, so that state counts as gone too.
+	static bool processAlive(const std::atomic<std::int32_t>& pid) {
+		pid_t process = pid_t(pid.load());
+		if (process <= 0) {
+			return true;
+		}
+		if (kill(process, 0) != 0 && errno == ESRCH) {
+			return false;
+		}
+		std::ifstream stat("/proc/" + std::to_string(process) + "/stat");
+		std::string line;
+		if (std::getline(stat, line)) {
+			std::size_t commandEnd = line.rfind(')');
+			return commandEnd == std::string::npos || commandEnd + 2 >= line.size() || line[commandEnd + 2] != 'Z';
+		}
+		return true;
+	}
+
+	bool map(int fd, std::size_t bytes) {
+		void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED) {
+			std::cerr << "Error mapping the shared memory ring " << name << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		header = static_cast<ShmRingHeader*>(address);
+		records = reinterpret_cast<ShmCarRecord*>(static_cast<char*>(address) + recordsOffset());
+		mappedBytes = bytes;
+		return true;
+	}
+
+	void unmap() {
+		if (header) {
+			munmap(header, mappedBytes);
+			header = nullptr;
+			records = nullptr;
+		}
+		if (owner) {
+			shm_unlink(name.c_str());
+			owner = false;
+		}
+	}
+
+	bool tryPush(const Car& car) {
+		std::uint64_t position = header->enqueuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			ShmCarRecord& record = records[position & mask];
+			std::uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+			std::int64_t difference = std::int64_t(sequence) - std::int64_t(position);
+			if (difference == 0) {
+				if (header->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					record.consumption = car.consumption;
+					record.power = car.power;
+					record.makeLength = std::uint32_t(car.make.size());
+					car.make.copy(record.make, car.make.size());
+					record.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false; // Full
+			}
+			else {
+				position = header->enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool tryPop(Car& car) {
+		std::uint64_t position = header->dequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			ShmCarRecord& record = records[position & mask];
+			std::uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+			std::int64_t difference = std::int64_t(sequence) - std::int64_t(position + 1);
+			if (difference == 0) {
+				if (header->dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					// The length comes from another process; never read past the record
+					car.make.assign(record.make, std::min<std::size_t>(record.makeLength, MAX_MAKE_LENGTH));
+					car.consumption = record.consumption;
+					car.power = record.power;
+					car.hashCode.clear();
+					car.performanceScore = 0.0;
+					record.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false; // Empty
+			}
+			else {
+				position = header->dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+public:
+	ShmCarRing() = default;
+
+	~ShmCarRing() {
+		unmap();
+	}
+
+	ShmCarRing(const ShmCarRing&) = delete;
+	ShmCarRing& operator=(const ShmCarRing&) = delete;
+
+	// Consumer side: create a fresh ring named like "/cars" (a segment left behind by a crashed run is replaced).
+	// The name is removed again when this object is destroyed.
+	bool create(const std::string& ringName, std::uint32_t capacity = DEFAULT_CAPACITY) {
+		unmap();
+		name = ringName;
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+			std::cerr << "The ring capacity must be a power of two." << std::endl;
+			return false;
+		}
+		shm_unlink(name.c_str());
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) {
+			std::cerr << "Error creating the shared memory ring " << name << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		owner = true;
+		bool mapped = ftruncate(fd, off_t(segmentBytes(capacity))) == 0 && map(fd, segmentBytes(capacity));
+		::close(fd);
+		if (!mapped) {
+			unmap();
+			return false;
+		}
+
+		// A fresh segment is zero-filled; set up the header and slot sequences, then publish it
+		header->magic = MAGIC;
+		header->version = VERSION;
+		header->capacity = capacity;
+		header->recordSize = sizeof(ShmCarRecord);
+		header->consumerPid.store(std::int32_t(getpid()));
+		mask = capacity - 1;
+		for (std::uint32_t i = 0; i < capacity; i++) {
+			records[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		header->ready.store(1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer side: attach to a ring created by the consumer, waiting up to timeoutMillis for it to appear.
+	// Fails if another process is already the ring's producer.
+	bool attach(const std::string& ringName, int timeoutMillis = 5000) {
+		unmap();
+		name = ringName;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+		int fd = -1;
+		struct stat status;
+		while (true) {
+			fd = shm_open(name.c_str(), O_RDWR, 0);
+			if (fd >= 0 && fstat(fd, &status) == 0 && std::size_t(status.st_size) >= recordsOffset()) {
+				break;
+			}
+			if (fd >= 0) {
+				::close(fd);
+			}
+			if ((fd < 0 && errno != ENOENT) || std::chrono::steady_clock::now() > deadline) {
+				std::cerr << "Error opening the shared memory ring " << name << ": "
+					<< (fd < 0 && errno != ENOENT ? std::strerror(errno) : "no consumer created it") << std::endl;
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		bool mapped = map(fd, std::size_t(status.st_size));
+		::close(fd);
+		if (!mapped) {
+			return false;
+		}
+
+		while (header->ready.load(std::memory_order_acquire) == 0) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				std::cerr << "The shared memory ring " << name << " was never initialised." << std::endl;
+				unmap();
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (header->magic != MAGIC || header->version != VERSION || header->recordSize != sizeof(ShmCarRecord)
+			|| mappedBytes < segmentBytes(header->capacity)) {
+			std::cerr << "The shared memory ring " << name << " has an incompatible layout." << std::endl;
+			unmap();
+			return false;
+		}
+		std::int32_t noProducer = 0;
+		if (!header->producerPid.compare_exchange_strong(noProducer, std::int32_t(getpid()))) {
+			std::cerr << "The shared memory ring " << name << " already has a producer (process " << noProducer << ")." << std::endl;
+			unmap();
+			return false;
+		}
+		mask = header->capacity - 1;
+		return true;
+	}
+
+	bool isOpen() const {
+		return header != nullptr;
+	}
+
+	std::uint32_t getCapacity() const {
+		return header ? header->capacity : 0;
+	}
+
+	// Queue a car, sleeping while the ring is full. Returns false if the make does not fit a record,
+	// the ring is already closed or the consumer process has gone.
+	bool push(const Car& car) {
+		if (car.make.size() > MAX_MAKE_LENGTH || header->closed.load(std::memory_order_acquire)) {
+			return false;
+		}
+		bool timedOut = false;
+		while (!tryPush(car)) {
+			if (header->closed.load(std::memory_order_acquire)) {
+				return false;
+			}
+			if (timedOut && !processAlive(header->consumerPid)) {
+				peerLost = true;
+				return false;
+			}
+			if (waitFor(header->spaceSignal, header->spaceWaiters, [&] { return tryPush(car); }, timedOut)) {
+				break;
+			}
+		}
+		signal(header->dataSignal, header->dataWaiters, 1);
+		return true;
+	}
+
+	// Take the next car, sleeping while the ring is empty. Returns false once the ring is closed and empty,
+	// or once it is empty and the producer process has gone without closing it.
+	bool pop(Car& car) {
+		bool timedOut = false;
+		while (true) {
+			if (tryPop(car)) {
+				break;
+			}
+			if (header->closed.load(std::memory_order_acquire)) {
+				// Every push happened before the close, so one more attempt sees all of them
+				if (!tryPop(car)) {
+					return false;
+				}
+				break;
+			}
+			if (timedOut && !processAlive(header->producerPid)) {
+				if (!tryPop(car)) {
+					peerLost = true;
+					return false;
+				}
+				break;
+			}
+			if (waitFor(header->dataSignal, header->dataWaiters, [&] { return tryPop(car); }, timedOut)) {
+				break;
+			}
+		}
+		signal(header->spaceSignal, header->spaceWaiters, 1);
+		return true;
+	}
+
+	// No more cars from the producer: wake every waiting consumer so it can drain the ring and stop
+	void close() {
+		header->closed.store(1, std::memory_order_release);
+		signal(header->dataSignal, header->dataWaiters, INT_MAX);
+		signal(header->spaceSignal, header->spaceWaiters, INT_MAX);
+	}
+
+	bool isClosed() const {
+		return header->closed.load(std::memory_order_acquire) != 0;
+	}
+
+	// Whether a push() or pop() gave up because the process on the other side exited without closing the ring
+	bool isPeerLost() const {
+		return peerLost;
+	}
+};
+
+#endif /* __linux__ */
+
+
+#endif /* SHM_RING_HPP */
@@ -0,0 +1,229 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include "car.hpp"
+#include "data_monitor.hpp"
+#include "wait_policy.hpp"
+
+
+// How CarPipeline hands cars to its workers
+enum class Dispatch {
+	Shared, // One DataMonitor that every worker takes from
+	RoundRobin, // One SpscCarQueue per worker, filled in turn
+	LeastLoaded // One SpscCarQueue per worker, each car to the emptiest one
+};
+
+inline const char* dispatchName(Dispatch dispatch) {
+	switch (dispatch) {
+	case Dispatch::RoundRobin: return "round-robin";
+	case Dispatch::LeastLoaded: return "least-loaded";
+	default: return "shared";
+	}
+}
+
+inline bool parseDispatch(const std::string& text, Dispatch& dispatch) {
+	if (text == "shared") dispatch = Dispatch::Shared;
+	else if (text == "round-robin") dispatch = Dispatch::RoundRobin;
+	else if (text == "least-loaded") dispatch = Dispatch::LeastLoaded;
+	else return false;
+	return true;
+}
+
+// Bounded single-producer/single-consumer queue of cars for one worker. A handoff is a release store
+// of the producer's or consumer's index plus an acquire load of the other one; each side caches the
+// other's index and only reloads it when the queue looks full or empty. There is no lock on that path.
+//
+// A side that finds the queue empty (or full) spins and yields according to its WaitPolicy and then
+// sleeps on a condition variable. It announces itself in a flag first, and the other side only takes
+// the sleep mutex to notify when the flag is set (an eventcount).
+//
+// Like DataMonitor, remove-side calls can be woken by wake() with a generation, and close() lets the
+// consumer drain what is queued and then stop.
+class SpscCarQueue {
+private:
+	struct Slot {
+		Car car;
+		std::chrono::steady_clock::time_point enqueued;
+	};
+
+	std::vector<Slot> slots;
+	std::size_t mask = 0;
+
+	// Producer side
+	alignas(64) std::atomic<std::size_t> tail{ 0 };
+	std::size_t cachedHead = 0;
+
+	// Consumer side
+	alignas(64) std::atomic<std::size_t> head{ 0 };
+	std::size_t cachedTail = 0;
+	QueueLatencyStats latencyStats; // Written by the consumer only
+
+	alignas(64) std::atomic<bool> consumerSleeping{ false };
+	std::atomic<bool> producerSleeping{ false };
+	std::atomic<bool> closed{ false };
+	std::atomic<unsigned> wakeGeneration{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable consumerWakeup;
+	std::condition_variable producerWakeup;
+	SpinWaiter consumerWait;
+	SpinWaiter producerWait;
+
+	// Wake the other side if it announced that it is going to sleep
+	void notify(std::atomic<bool>& sleeping, std::condition_variable& wakeup) {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wakeup.notify_one();
+		}
+	}
+
+	// Sleep until ready() holds, unless it already does once the flag is visible to the other side
+	template <class Ready>
+	void sleepUntil(std::atomic<bool>& sleeping, std::condition_variable& wakeup, Ready ready) {
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (!ready()) {
+			wakeup.wait(lock);
+		}
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+
+	bool isEmpty() {
+		if (cachedTail == head.load(std::memory_order_relaxed)) {
+			cachedTail = tail.load(std::memory_order_acquire);
+		}
+		return cachedTail == head.load(std::memory_order_relaxed);
+	}
+
+	bool isFull() {
+		std::size_t position = tail.load(std::memory_order_relaxed);
+		if (position - cachedHead == slots.size()) {
+			cachedHead = head.load(std::memory_order_acquire);
+		}
+		return position - cachedHead == slots.size();
+	}
+
+public:
+	explicit SpscCarQueue(std::size_t capacity = 16, WaitPolicy policy = WaitPolicy::Park) {
+		std::size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		slots.resize(size);
+		mask = size - 1;
+		consumerWait.setPolicy(policy);
+		producerWait.setPolicy(policy);
+	}
+
+	SpscCarQueue(const SpscCarQueue&) = delete;
+	SpscCarQueue& operator=(const SpscCarQueue&) = delete;
+
+	// Producer: queue a car, waiting while the queue is full. Returns false if the queue was closed.
+	bool push(Car car) {
+		if (isFull()) {
+			auto hasSpace = [&] { return !isFull() || closed; };
+			if (!producerWait.spinUntil(hasSpace)) {
+				sleepUntil(producerSleeping, producerWakeup, hasSpace);
+			}
+		}
+		if (closed) {
+			return false;
+		}
+		std::size_t position = tail.load(std::memory_order_relaxed);
+		Slot& slot = slots[position & mask];
+		slot.car = std::move(car);
+		slot.enqueued = std::chrono::steady_clock::now();
+		tail.store(position + 1, std::memory_order_release);
+		notify(consumerSleeping, consumerWakeup);
+		return true;
+	}
+
+	// Consumer: take the oldest car, waiting while the queue is empty. Returns false once the queue is
+	// closed and empty, or, with seenWakeGeneration, once wake() was called since that generation.
+	bool pop(Car& car, long long* queuedNanos = nullptr, const unsigned* seenWakeGeneration = nullptr) {
+		if (isEmpty()) {
+			auto ready = [&] {
+				return !isEmpty() || closed || (seenWakeGeneration && *seenWakeGeneration != wakeGeneration);
+			};
+			if (!consumerWait.spinUntil(ready)) {
+				sleepUntil(consumerSleeping, consumerWakeup, ready);
+			}
+		}
+		return tryPop(car, queuedNanos);
+	}
+
+	// Consumer: take the oldest car if there is one
+	bool tryPop(Car& car, long long* queuedNanos = nullptr) {
+		if (isEmpty()) {
+			return false;
+		}
+		std::size_t position = head.load(std::memory_order_relaxed);
+		Slot& slot = slots[position & mask];
+		car = std::move(slot.car);
+		long long waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - slot.enqueued).count();
+		head.store(position + 1, std::memory_order_release);
+		notify(producerSleeping, producerWakeup);
+
+		latencyStats.count++;
+		latencyStats.totalNanos += waited;
+		latencyStats.maxNanos = std::max(latencyStats.maxNanos, waited);
+		if (queuedNanos) {
+			*queuedNanos = waited;
+		}
+		return true;
+	}
+
+	// Cars queued right now, as seen by the producer; used to pick the least-loaded queue
+	std::size_t size() const {
+		return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+	}
+
+	// Stop accepting cars and wake both sides; queued cars are still handed out
+	void close() {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		closed = true;
+		consumerWakeup.notify_all();
+		producerWakeup.notify_all();
+	}
+
+	bool isClosed() const {
+		return closed;
+	}
+
+	// Wake a consumer waiting in pop() with a wake generation, without handing it a car
+	void wake() {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeGeneration++;
+		consumerWakeup.notify_all();
+	}
+
+	unsigned getWakeGeneration() const {
+		return wakeGeneration;
+	}
+
+	// Only meaningful once the consumer has stopped
+	QueueLatencyStats getLatencyStats() const {
+		return latencyStats;
+	}
+
+	WaitStats getConsumerWaitStats() const {
+		return consumerWait.getStats();
+	}
+
+	WaitStats getProducerWaitStats() const {
+		return producerWait.getStats();
+	}
+};
+
+
+#endif /* SPSC_QUEUE_HPP */
@@ -0,0 +1,204 @@
+#ifndef STAGE_STATS_HPP
+#define STAGE_STATS_HPP
+
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+
+
+// Pipeline stages that are timed
+enum class Stage { Read, Parse, QueueWait, Hash, ScoreFilter, ResultInsert, Output, Count };
+
+inline const char* stageName(Stage stage) {
+	switch (stage) {
+	case Stage::Read: return "read";
+	case Stage::Parse: return "parse";
+	case Stage::QueueWait: return "queue wait";
+	case Stage::Hash: return "hash";
+	case Stage::ScoreFilter: return "score/filter";
+	case Stage::ResultInsert: return "result insert";
+	case Stage::Output: return "output";
+	default: return "";
+	}
+}
+
+
+// Log-bucketed histogram of nanosecond durations, in the style of HdrHistogram:
+// every power of two is split into 16 linear sub-buckets, so any recorded value is
+// reported within 1/16 (about 6%) of its real value, with a fixed 1 KiB-ish footprint.
+class LogHistogram {
+private:
+	static const int subBucketBits = 4;
+	static const int subBuckets = 1 << subBucketBits;
+	static const int bucketCount = subBuckets + (64 - subBucketBits) * subBuckets;
+
+	std::array<uint64_t, bucketCount> counts{};
+	uint64_t total = 0;
+	uint64_t maxValue = 0;
+
+	static int bucketIndex(uint64_t value) {
+		if (value < uint64_t(subBuckets)) {
+			return int(value);
+		}
+		int exponent = 63;
+		while (!(value >> exponent)) {
+			exponent--;
+		}
+		int sub = int((value >> (exponent - subBucketBits)) & (subBuckets - 1));
+		return subBuckets + (exponent - subBucketBits) * subBuckets + sub;
+	}
+
+	// Midpoint of the values that fall into a bucket
+	static uint64_t bucketValue(int index) {
+		if (index < subBuckets) {
+			return uint64_t(index);
+		}
+		int exponent = (index - subBuckets) / subBuckets + subBucketBits;
+		uint64_t sub = uint64_t((index - subBuckets) % subBuckets);
+		uint64_t width = uint64_t(1) << (exponent - subBucketBits);
+		return (uint64_t(1) << exponent) + sub * width + width / 2;
+	}
+
+public:
+	void record(uint64_t nanos) {
+		counts[bucketIndex(nanos)]++;
+		total++;
+		if (nanos > maxValue) {
+			maxValue = nanos;
+		}
+	}
+
+	void merge(const LogHistogram& other) {
+		for (int i = 0; i < bucketCount; i++) {
+			counts[i] += other.counts[i];
+		}
+		total += other.total;
+		if (other.maxValue > maxValue) {
+			maxValue = other.maxValue;
+		}
+	}
+
+	uint64_t count() const {
+		return total;
+	}
+
+	uint64_t max() const {
+		return maxValue;
+	}
+
+	// Value at a quantile in [0, 1]
+	uint64_t percentile(double quantile) const {
+		if (total == 0) {
+			return 0;
+		}
+		uint64_t rank = uint64_t(quantile * double(total));
+		if (rank >= total) {
+			rank = total - 1;
+		}
+		uint64_t seen = 0;
+		for (int i = 0; i < bucketCount; i++) {
+			seen += counts[i];
+			if (seen > rank) {
+				uint64_t value = bucketValue(i);
+				return value < maxValue ? value : maxValue;
+			}
+		}
+		return maxValue;
+	}
+};
+
+
+// Per-thread timings of every stage; merged into StageStats once the thread is done
+struct StageRecorder {
+	std::array<LogHistogram, size_t(Stage::Count)> histograms;
+	std::array<uint64_t, size_t(Stage::Count)> totalNanos{};
+	std::array<uint64_t, size_t(Stage::Count)> records{};
+
+	// Record one sample that covered `recordCount` records (e.g. a whole-file read)
+	void record(Stage stage, uint64_t nanos, uint64_t recordCount = 1) {
+		size_t index = size_t(stage);
+		histograms[index].record(nanos);
+		totalNanos[index] += nanos;
+		records[index] += recordCount;
+	}
+
+	void merge(const StageRecorder& other) {
+		for (size_t i = 0; i < size_t(Stage::Count); i++) {
+			histograms[i].merge(other.histograms[i]);
+			totalNanos[i] += other.totalNanos[i];
+			records[i] += other.records[i];
+		}
+	}
+};
+
+// Steady clock stopwatch for one stage sample
+class StageTimer {
+private:
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+	uint64_t elapsedNanos() const {
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	// Record the time since construction (or the last lap) and restart
+	void lap(StageRecorder& recorder, Stage stage, uint64_t recordCount = 1) {
+		auto now = std::chrono::steady_clock::now();
+		recorder.record(stage, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count()), recordCount);
+		start = now;
+	}
+};
+
+
+// Process-wide stage statistics, merged from the per-thread recorders
+class StageStats {
+private:
+	std::mutex statsMutex;
+	StageRecorder merged;
+
+public:
+	void merge(const StageRecorder& recorder) {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		merged.merge(recorder);
+	}
+
+	// Print p50/p99/p999/max per sample and records/second of time spent in each stage
+	void printSummary(std::ostream& out) {
+		std::lock_guard<std::mutex> lock(statsMutex);
+		std::ios_base::fmtflags flags = out.flags();
+		std::streamsize precision = out.precision();
+		out << " " << std::left << std::setw(14) << "Stage" << std::right
+			<< std::setw(10) << "samples"
+			<< std::setw(11) << "p50 us"
+			<< std::setw(11) << "p99 us"
+			<< std::setw(11) << "p999 us"
+			<< std::setw(11) << "max us"
+			<< std::setw(14) << "records/s" << '\n';
+		for (size_t i = 0; i < size_t(Stage::Count); i++) {
+			const LogHistogram& histogram = merged.histograms[i];
+			if (histogram.count() == 0) {
+				continue;
+			}
+			double seconds = merged.totalNanos[i] / 1e9;
+			out << " " << std::left << std::setw(14) << stageName(Stage(i)) << std::right
+				<< std::setw(10) << histogram.count()
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(11) << histogram.percentile(0.50) / 1000.0
+				<< std::setw(11) << histogram.percentile(0.99) / 1000.0
+				<< std::setw(11) << histogram.percentile(0.999) / 1000.0
+				<< std::setw(11) << histogram.max() / 1000.0
+				<< std::setprecision(0)
+				<< std::setw(14) << (seconds > 0 ? merged.records[i] / seconds : 0.0) << '\n';
+		}
+		out.flags(flags);
+		out.precision(precision);
+	}
+};
+
+
+#endif /* STAGE_STATS_HPP */
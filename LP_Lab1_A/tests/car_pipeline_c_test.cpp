@@ -0,0 +1,76 @@
+// C interface under concurrent submitters: several threads submit cars, and some submit calls fail on purpose.
+// Every car must reach the result, and each thread must see the error of its own calls only.
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../car_pipeline_c.h"
+
+using namespace std;
+
+int main() {
+	const int threadCount = 4;
+	const int carsPerThread = 20000;
+
+	car_pipeline* pipeline = car_pipeline_create();
+	if (!pipeline) {
+		return 1;
+	}
+	car_pipeline_config config;
+	car_pipeline_config_init(&config);
+	config.dispatch = CAR_PIPELINE_DISPATCH_ROUND_ROBIN;
+	config.min_power = -1; // Every car passes
+	if (car_pipeline_configure(pipeline, &config) != 0) {
+		cerr << "configure failed: " << car_pipeline_last_error(pipeline) << endl;
+		return 1;
+	}
+
+	// A successful call on another thread must not clear this thread's error
+	atomic<int> wrongErrors{ 0 };
+	if (car_pipeline_submit(pipeline, nullptr, 1) != -1) {
+		wrongErrors++;
+	}
+	thread([&] {
+		car_input car = { "Other", 5.5, 1 };
+		if (car_pipeline_submit(pipeline, &car, 1) != 0 || car_pipeline_last_error(pipeline)[0] != '\0') {
+			wrongErrors++;
+		}
+	}).join();
+	if (strcmp(car_pipeline_last_error(pipeline), "no cars given") != 0) {
+		cerr << "The error of this thread was replaced by: '" << car_pipeline_last_error(pipeline) << "'" << endl;
+		wrongErrors++;
+	}
+
+	vector<thread> submitters;
+	for (int t = 0; t < threadCount; t++) {
+		submitters.emplace_back([&, t] {
+			string make = "Make" + to_string(t);
+			for (int i = 0; i < carsPerThread; i++) {
+				car_input car = { make.c_str(), 5.5, i };
+				if (car_pipeline_submit(pipeline, &car, 1) != 0 || car_pipeline_last_error(pipeline)[0] != '\0') {
+					wrongErrors++;
+				}
+				if (i % 100 == 0 && (car_pipeline_submit(pipeline, nullptr, 1) != -1
+					|| strcmp(car_pipeline_last_error(pipeline), "no cars given") != 0)) {
+					wrongErrors++;
+				}
+			}
+		});
+	}
+	for (auto& submitter : submitters) {
+		submitter.join();
+	}
+
+	int received = car_pipeline_drain(pipeline);
+	size_t resultCount = 0;
+	car_pipeline_results(pipeline, &resultCount);
+	car_pipeline_destroy(pipeline);
+
+	bool ok = wrongErrors == 0 && received == threadCount * carsPerThread + 1 && resultCount == size_t(received);
+	cout << "Submitted " << threadCount * carsPerThread + 1 << " cars, drained " << received << ", "
+		<< wrongErrors << " calls saw a wrong error" << (ok ? "" : " - MISMATCH") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+# Generates SHARDS input shards and runs LP_Lab1_A on them with several loader threads, once with the shared
+# DataMonitor and once with each per-worker dispatch, and fails unless every run writes the same result.txt.
+# All loader threads submit at once, so the per-worker queues must not lose or corrupt cars.
+# Usage: cmake -DPROGRAM=... -DGENERATOR=... -DWORK_DIR=... [-DSHARDS=N] [-DCARS=N] -P loaders_dispatch_test.cmake
+
+if(NOT SHARDS)
+	set(SHARDS 8)
+endif()
+if(NOT CARS)
+	set(CARS 20000)
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/shards")
+foreach(shard RANGE 1 ${SHARDS})
+	execute_process(COMMAND "${GENERATOR}" --count ${CARS} --format ndjson --seed ${shard} --out "${WORK_DIR}/shards/cars${shard}.ndjson"
+		RESULT_VARIABLE status OUTPUT_QUIET)
+	if(status)
+		message(FATAL_ERROR "Generating shard ${shard} failed: ${status}")
+	endif()
+endforeach()
+
+set(options --quiet --no-cache --no-memo --loaders ${SHARDS})
+foreach(dispatch shared round-robin least-loaded)
+	execute_process(COMMAND "${PROGRAM}" "${WORK_DIR}/shards" ${options} --dispatch ${dispatch} WORKING_DIRECTORY "${WORK_DIR}"
+		RESULT_VARIABLE status OUTPUT_QUIET TIMEOUT 60)
+	if(status)
+		message(FATAL_ERROR "The --dispatch ${dispatch} run failed: ${status}")
+	endif()
+	file(READ "${WORK_DIR}/result.txt" result_${dispatch})
+endforeach()
+
+foreach(dispatch round-robin least-loaded)
+	if(NOT result_${dispatch} STREQUAL result_shared)
+		message(FATAL_ERROR "--dispatch ${dispatch} with ${SHARDS} loaders wrote a different result than --dispatch shared (see ${WORK_DIR})")
+	endif()
+endforeach()
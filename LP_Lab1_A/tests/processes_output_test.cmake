@@ -0,0 +1,24 @@
+# Runs LP_Lab1_A on INPUT in one process and with --processes 3, and fails unless both write the same
+# result.txt. The input has consumptions with more than one decimal, which must survive the hand-off to
+# the worker processes. Usage: cmake -DPROGRAM=... -DINPUT=... -DWORK_DIR=... -P processes_output_test.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(options --quiet --no-cache --no-memo --order make:desc,score:desc,hash:asc)
+
+execute_process(COMMAND "${PROGRAM}" "${INPUT}" ${options} WORKING_DIRECTORY "${WORK_DIR}" RESULT_VARIABLE status OUTPUT_QUIET)
+if(status)
+	message(FATAL_ERROR "The single-process run failed: ${status}")
+endif()
+file(RENAME "${WORK_DIR}/result.txt" "${WORK_DIR}/single.txt")
+
+execute_process(COMMAND "${PROGRAM}" "${INPUT}" ${options} --processes 3 WORKING_DIRECTORY "${WORK_DIR}" RESULT_VARIABLE status OUTPUT_QUIET)
+if(status)
+	message(FATAL_ERROR "The --processes 3 run failed: ${status}")
+endif()
+
+file(READ "${WORK_DIR}/single.txt" single)
+file(READ "${WORK_DIR}/result.txt" sharded)
+if(NOT single STREQUAL sharded)
+	message(FATAL_ERROR "--processes 3 wrote a different result than the single-process run (see ${WORK_DIR})")
+endif()
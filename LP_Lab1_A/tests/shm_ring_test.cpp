@@ -0,0 +1,67 @@
+// Shared-memory ring under backpressure: a small ring, one producer and several consumers.
+// Every pushed car must be popped exactly once, and the ring accepts no second producer.
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../shm_ring.hpp"
+
+using namespace std;
+
+int main() {
+	const int carCount = 2000000;
+	const int consumerCount = 3;
+	string name = "/lp_ring_test_" + to_string(getpid());
+
+	ShmCarRing consumerRing;
+	if (!consumerRing.create(name, 8)) {
+		return 1;
+	}
+	ShmCarRing producerRing;
+	if (!producerRing.attach(name)) {
+		return 1;
+	}
+	ShmCarRing secondProducer;
+	bool secondAttached = secondProducer.attach(name, 0);
+
+	atomic<long long> popped{ 0 };
+	atomic<long long> poppedPowerSum{ 0 };
+	vector<thread> consumers;
+	for (int i = 0; i < consumerCount; i++) {
+		consumers.emplace_back([&] {
+			Car car;
+			while (consumerRing.pop(car)) {
+				popped++;
+				poppedPowerSum += car.power;
+			}
+		});
+	}
+
+	long long pushed = 0;
+	long long pushedPowerSum = 0;
+	bool pushFailed = false;
+	Car car;
+	car.make = "Volvo";
+	car.consumption = 5.25;
+	for (int i = 0; i < carCount; i++) {
+		car.power = i;
+		if (!producerRing.push(car)) {
+			pushFailed = true;
+			break;
+		}
+		pushed++;
+		pushedPowerSum += i;
+	}
+	producerRing.close();
+	for (auto& consumer : consumers) {
+		consumer.join();
+	}
+
+	bool ok = !secondAttached && !pushFailed && pushed == carCount && popped == pushed && poppedPowerSum == pushedPowerSum;
+	cout << "Pushed " << pushed << " cars, popped " << popped << (secondAttached ? ", a second producer attached" : "")
+		<< (ok ? "" : " - MISMATCH") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#ifndef TOP_K_HPP
+#define TOP_K_HPP
+
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "car.hpp"
+#include "car_ordering.hpp"
+
+
+// Bounded heap that keeps the first K cars of an ordering seen so far.
+// The worst kept car sits at the top, so a new car costs one comparison when it is not
+// good enough and O(log K) when it replaces the worst one. Each call picks the specialised
+// comparator for the ordering once (like sortCars), so the heap operations inline it.
+class TopKHeap {
+private:
+	std::vector<Car> heap;
+	std::size_t limit;
+	RuntimeCarLess runtimeLess; // Orderings without a specialised comparator
+
+	// Call fn with the comparator for the ordering
+	template <class Fn>
+	void withLess(Fn&& fn) const {
+		if (!withSpecialisedLess(runtimeLess.order, fn)) {
+			fn(runtimeLess);
+		}
+	}
+
+	template <class Less>
+	void pushWith(const Car& car, const Less& better) {
+		if (heap.size() < limit) {
+			heap.push_back(car);
+			std::push_heap(heap.begin(), heap.end(), better);
+		}
+		else if (better(car, heap.front())) {
+			std::pop_heap(heap.begin(), heap.end(), better);
+			heap.back() = car;
+			std::push_heap(heap.begin(), heap.end(), better);
+		}
+	}
+
+public:
+	// Room for up to INITIAL_CAPACITY cars up front; a larger K grows the heap only as cars arrive,
+	// so a huge K costs nothing before there is data to keep.
+	static constexpr std::size_t INITIAL_CAPACITY = 1024;
+
+	TopKHeap(std::size_t k, SortOrder ordering) : limit(k), runtimeLess{ std::move(ordering) } {
+		heap.reserve(std::min(k, INITIAL_CAPACITY));
+	}
+
+	void push(const Car& car) {
+		if (limit == 0) {
+			return;
+		}
+		withLess([&](const auto& better) { pushWith(car, better); });
+	}
+
+	// Merge another heap's cars into this one
+	void merge(const std::vector<Car>& cars) {
+		if (limit == 0) {
+			return;
+		}
+		withLess([&](const auto& better) {
+			for (const auto& car : cars) {
+				pushWith(car, better);
+			}
+		});
+	}
+
+	// Kept cars in heap order (unsorted)
+	const std::vector<Car>& items() const {
+		return heap;
+	}
+
+	// Kept cars, best first
+	std::vector<Car> sorted() const {
+		std::vector<Car> result = heap;
+		withLess([&](const auto& better) { std::sort_heap(result.begin(), result.end(), better); });
+		return result;
+	}
+
+	std::size_t size() const {
+		return heap.size();
+	}
+};
+
+
+#endif /* TOP_K_HPP */
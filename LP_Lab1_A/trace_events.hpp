@@ -0,0 +1,193 @@
+#ifndef TRACE_EVENTS_HPP
+#define TRACE_EVENTS_HPP
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+
+// One complete ("X") trace event
+struct TraceEvent {
+	const char* name; // Must be a string literal
+	uint64_t startNanos;
+	uint64_t durationNanos;
+	char car[24]; // Make of the car the span belongs to, truncated
+};
+
+// Fixed-size ring of events owned by one thread. When it is full the oldest events are
+// overwritten, so a long run keeps its most recent history and never allocates while tracing.
+class TraceBuffer {
+private:
+	std::vector<TraceEvent> events;
+	uint64_t written = 0;
+
+public:
+	int threadId;
+	std::string threadName;
+
+	TraceBuffer(size_t capacity, int id) : events(capacity), threadId(id) {}
+
+	void append(const char* name, uint64_t startNanos, uint64_t durationNanos, const char* car) {
+		TraceEvent& event = events[written % events.size()];
+		event.name = name;
+		event.startNanos = startNanos;
+		event.durationNanos = durationNanos;
+		std::memcpy(event.car, car, sizeof(event.car));
+		written++;
+	}
+
+	// Events in the order they were recorded
+	template <class Fn>
+	void forEach(Fn&& fn) const {
+		uint64_t first = written > events.size() ? written - events.size() : 0;
+		for (uint64_t i = first; i < written; i++) {
+			fn(events[i % events.size()]);
+		}
+	}
+
+	uint64_t dropped() const {
+		return written > events.size() ? written - events.size() : 0;
+	}
+};
+
+
+// Process-wide registry of the per-thread buffers; writes the Chrome/Perfetto trace_event JSON
+class TraceLog {
+private:
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<TraceBuffer>> buffers; // Outlive the threads that wrote them
+	std::atomic<bool> enabled{ false };
+	size_t bufferCapacity = 1 << 16;
+	std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+public:
+	static TraceLog& instance() {
+		static TraceLog log;
+		return log;
+	}
+
+	// Start recording; every thread gets a ring of `capacity` events
+	void enable(size_t capacity) {
+		bufferCapacity = capacity == 0 ? 1 : capacity;
+		origin = std::chrono::steady_clock::now();
+		enabled = true;
+	}
+
+	bool isEnabled() const {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	uint64_t now() const {
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+	}
+
+	// The calling thread's buffer, created on first use
+	TraceBuffer& threadBuffer() {
+		thread_local TraceBuffer* buffer = nullptr;
+		if (!buffer) {
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffers.push_back(std::make_unique<TraceBuffer>(bufferCapacity, int(buffers.size()) + 1));
+			buffer = buffers.back().get();
+			buffer->threadName = "thread " + std::to_string(buffer->threadId);
+		}
+		return *buffer;
+	}
+
+	void setThreadName(const std::string& name) {
+		if (isEnabled()) {
+			threadBuffer().threadName = name;
+		}
+	}
+
+	// Write every recorded event; call once all traced threads have finished
+	bool write(const std::string& path) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		std::ofstream traceFile(path);
+		if (!traceFile) {
+			std::cerr << "Error opening the trace file." << std::endl;
+			return false;
+		}
+
+		nlohmann::json events = nlohmann::json::array();
+		uint64_t dropped = 0;
+		for (const auto& buffer : buffers) {
+			events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", buffer->threadId },
+				{ "args", { { "name", buffer->threadName } } } });
+			buffer->forEach([&](const TraceEvent& event) {
+				nlohmann::json traceEvent = {
+					{ "name", event.name },
+					{ "cat", "pipeline" },
+					{ "ph", "X" },
+					{ "pid", 1 },
+					{ "tid", buffer->threadId },
+					{ "ts", event.startNanos / 1000.0 },
+					{ "dur", event.durationNanos / 1000.0 }
+				};
+				if (event.car[0] != '\0') {
+					traceEvent["args"] = { { "car", event.car } };
+				}
+				events.push_back(traceEvent);
+			});
+			dropped += buffer->dropped();
+		}
+
+		nlohmann::json trace;
+		trace["traceEvents"] = events;
+		trace["displayTimeUnit"] = "ns";
+		traceFile << trace.dump() << std::endl;
+		if (dropped > 0) {
+			std::cerr << "Trace buffers wrapped; " << dropped << " oldest events were dropped." << std::endl;
+		}
+		return true;
+	}
+};
+
+
+// Records the lifetime of a scope as one span on the calling thread, when tracing is on.
+// The car's make is copied when it is given, so the car may be moved or reused afterwards.
+class TraceSpan {
+private:
+	const char* name;
+	char car[sizeof(TraceEvent::car)] = {};
+	uint64_t start = 0;
+	bool active;
+
+public:
+	explicit TraceSpan(const char* spanName, const std::string* carMake = nullptr)
+		: name(spanName), active(TraceLog::instance().isEnabled()) {
+		if (active) {
+			setCar(carMake);
+			start = TraceLog::instance().now();
+		}
+	}
+
+	// Attach the car once it is known (e.g. after remove() took it from the buffer)
+	void setCar(const std::string* carMake) {
+		if (active && carMake) {
+			size_t length = carMake->copy(car, sizeof(car) - 1);
+			car[length] = '\0';
+		}
+	}
+
+	~TraceSpan() {
+		if (active) {
+			TraceLog& log = TraceLog::instance();
+			log.threadBuffer().append(name, start, log.now() - start, car);
+		}
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+
+#endif /* TRACE_EVENTS_HPP */
@@ -0,0 +1,156 @@
+#ifndef UNIX_SOCKET_SERVER_HPP
+#define UNIX_SOCKET_SERVER_HPP
+
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SIGPIPE is ignored instead
+#endif
+
+
+// Set by SIGINT/SIGTERM; the accept loop checks it after accept() is interrupted
+inline volatile std::sig_atomic_t serverStopRequested = 0;
+
+inline void requestServerStop(int) {
+	serverStopRequested = 1;
+}
+
+// Install SIGINT/SIGTERM handlers without SA_RESTART, so a blocked accept() or read() returns EINTR
+inline void installServerStopHandlers() {
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = requestServerStop;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+// Listening Unix domain stream socket. The socket file is removed again when the server is destroyed.
+class UnixSocketServer {
+private:
+	std::string path;
+	int listenFd = -1;
+
+public:
+	explicit UnixSocketServer(const std::string& socketPath) : path(socketPath) {}
+
+	~UnixSocketServer() {
+		if (listenFd >= 0) {
+			close(listenFd);
+			unlink(path.c_str());
+		}
+	}
+
+	UnixSocketServer(const UnixSocketServer&) = delete;
+	UnixSocketServer& operator=(const UnixSocketServer&) = delete;
+
+	// Bind and listen, replacing a stale socket file left by a previous server
+	bool listen(int backlog = 16) {
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			std::cerr << "Socket path is too long: " << path << std::endl;
+			return false;
+		}
+		path.copy(address.sun_path, path.size());
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listenFd < 0) {
+			std::cerr << "Error creating the socket: " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		unlink(path.c_str());
+		if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+			|| ::listen(listenFd, backlog) < 0) {
+			std::cerr << "Error listening on " << path << ": " << std::strerror(errno) << std::endl;
+			close(listenFd);
+			listenFd = -1;
+			return false;
+		}
+		return true;
+	}
+
+	// Wait for the next client. Returns -1 if interrupted by a signal.
+	int accept() {
+		return ::accept(listenFd, nullptr, nullptr);
+	}
+};
+
+// Reads newline-terminated requests from a connected socket. Lines handed out stay in the buffer
+// until the next read, so a burst of many requests costs one compaction per read, not one per line.
+class SocketLineReader {
+private:
+	int fd;
+	std::string pending;
+	size_t start = 0; // First byte of pending not handed out yet
+	size_t scanned = 0; // pending before this offset holds no newline after start
+
+public:
+	explicit SocketLineReader(int socketFd) : fd(socketFd) {}
+
+	// Read the next line without its newline. Returns false once the peer closed the connection.
+	bool readLine(std::string& line) {
+		while (true) {
+			size_t newline = pending.find('\n', scanned);
+			if (newline != std::string::npos) {
+				line.assign(pending, start, newline - start);
+				start = newline + 1;
+				scanned = start;
+				return true;
+			}
+			pending.erase(0, start);
+			start = 0;
+			scanned = pending.size();
+
+			char chunk[64 * 1024];
+			ssize_t got = read(fd, chunk, sizeof(chunk));
+			if (got < 0 && errno == EINTR) {
+				continue;
+			}
+			if (got <= 0) {
+				// A final request without a trailing newline still counts
+				if (!pending.empty()) {
+					line.swap(pending);
+					pending.clear();
+					scanned = 0;
+					return true;
+				}
+				return false;
+			}
+			pending.append(chunk, size_t(got));
+		}
+	}
+};
+
+// Write the whole buffer, retrying short writes. Returns false if the peer went away.
+inline bool writeAll(int fd, const std::string& data) {
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t sent = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		written += size_t(sent);
+	}
+	return true;
+}
+
+#endif /* _WIN32 */
+
+
+#endif /* UNIX_SOCKET_SERVER_HPP */
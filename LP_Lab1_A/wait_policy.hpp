@@ -0,0 +1,139 @@
+#ifndef WAIT_POLICY_HPP
+#define WAIT_POLICY_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// How a thread waits for a monitor condition that is not met yet
+enum class WaitPolicy {
+	Park, // Block on the condition variable at once: no CPU spent, but every wake-up goes through the scheduler
+	Spin, // Spin with pause instructions for a fixed budget, then yield a few times, then park
+	Adaptive // Like Spin, with a budget that grows while spinning pays off and shrinks while it does not
+};
+
+inline const char* waitPolicyName(WaitPolicy policy) {
+	switch (policy) {
+	case WaitPolicy::Spin: return "spin";
+	case WaitPolicy::Adaptive: return "adaptive";
+	default: return "park";
+	}
+}
+
+inline bool parseWaitPolicy(const std::string& text, WaitPolicy& policy) {
+	if (text == "park") policy = WaitPolicy::Park;
+	else if (text == "spin") policy = WaitPolicy::Spin;
+	else if (text == "adaptive") policy = WaitPolicy::Adaptive;
+	else return false;
+	return true;
+}
+
+// Tell the core this is a spin loop (PAUSE on x86, YIELD on ARM)
+inline void cpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
+// Outcomes of the waits that did not find their condition met at once
+struct WaitStats {
+	long long spinHits = 0; // Met while spinning
+	long long yieldHits = 0; // Met while yielding
+	long long parks = 0; // Had to block
+	int spinLimit = 0; // Current spin budget
+
+	long long waits() const {
+		return spinHits + yieldHits + parks;
+	}
+};
+
+// The spin and yield phases in front of a blocking wait. The budget is shared by every thread waiting
+// on the same condition; with the adaptive policy each wait that ends while spinning moves it towards
+// twice the spins it needed, and each wait that has to yield or park halves it.
+class SpinWaiter {
+public:
+	static constexpr int MIN_SPINS = 16;
+	static constexpr int MAX_SPINS = 16384;
+	static constexpr int DEFAULT_SPINS = 1024;
+	static constexpr int YIELDS = 4;
+
+private:
+	WaitPolicy policy = WaitPolicy::Park;
+	std::atomic<int> spinLimit{ DEFAULT_SPINS };
+	std::atomic<long long> spinHits{ 0 };
+	std::atomic<long long> yieldHits{ 0 };
+	std::atomic<long long> parks{ 0 };
+
+public:
+	// On one CPU the thread being waited for cannot run while this one spins, so waiters go straight to yielding
+	static bool spinningUseful() {
+		static const bool useful = std::thread::hardware_concurrency() > 1;
+		return useful;
+	}
+
+	void setPolicy(WaitPolicy waitPolicy) {
+		policy = waitPolicy;
+		spinLimit = DEFAULT_SPINS;
+	}
+
+	WaitPolicy getPolicy() const {
+		return policy;
+	}
+
+	// Poll ready() through the spin and yield phases. Returns true once it holds; false means the caller
+	// should park. Call without holding the monitor lock.
+	template <class Ready>
+	bool spinUntil(Ready ready) {
+		if (policy == WaitPolicy::Park) {
+			return false;
+		}
+		int limit = spinningUseful() ? spinLimit.load(std::memory_order_relaxed) : 0;
+		for (int spins = 0; spins < limit; spins++) {
+			if (ready()) {
+				if (policy == WaitPolicy::Adaptive) {
+					int target = std::min(MAX_SPINS, std::max(MIN_SPINS, spins * 2));
+					spinLimit.store(limit + (target - limit) / 8, std::memory_order_relaxed);
+				}
+				spinHits.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			cpuRelax();
+		}
+
+		if (policy == WaitPolicy::Adaptive && limit > 0) {
+			spinLimit.store(std::max(MIN_SPINS, limit / 2), std::memory_order_relaxed);
+		}
+		for (int yields = 0; yields < YIELDS; yields++) {
+			std::this_thread::yield();
+			if (ready()) {
+				yieldHits.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		parks.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	WaitStats getStats() const {
+		WaitStats stats;
+		stats.spinHits = spinHits;
+		stats.yieldHits = yieldHits;
+		stats.parks = parks;
+		stats.spinLimit = spinningUseful() ? spinLimit.load() : 0;
+		return stats;
+	}
+};
+
+
+#endif /* WAIT_POLICY_HPP */